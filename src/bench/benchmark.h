@@ -0,0 +1,115 @@
+// Molecular dynamics playground
+// Minimal timing harness for the benchmark suite (md_bench)
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bench
+{
+    // Make the compiler assume value is read and written, so the computation producing it is not optimized away
+    template<class T>
+    inline void doNotOptimize(T& value)
+    {
+#ifdef _MSC_VER
+        volatile auto* sink = &value;
+        (void)sink;
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : "+m"(value) : : "memory");
+#endif
+    }
+
+    // Force pending stores to memory, and reloads of anything read afterwards
+    inline void clobberMemory()
+    {
+#ifdef _MSC_VER
+        _ReadWriteBarrier();
+#else
+        asm volatile("" : : : "memory");
+#endif
+    }
+
+    struct Result
+    {
+        std::string name;
+        double nsPerOp = 0; // Median over repetitions
+        double nsPerOpMin = 0;
+        double flopsPerOp = 0; // 0 when the operation has no meaningful flop count
+        uint64_t numOps = 0;
+
+        // Extra fields for simulation steps, where an op is one time step
+        int numAtoms = 0;
+        double atomStepsPerSecond = 0;
+        double listRebuildsPerStep = 0;
+
+        double gflops() const { return nsPerOp > 0 ? flopsPerOp / nsPerOp : 0; }
+    };
+
+    class Runner
+    {
+    public:
+        double minTime = 0.5; // Seconds spent measuring each benchmark
+        int repetitions = 5;
+        std::string filter; // Only run benchmarks whose name contains this
+
+        bool enabled(std::string_view name) const
+        {
+            return filter.empty() || name.find(filter) != std::string_view::npos;
+        }
+
+        // Time op(), which performs opsPerCall operations of flopsPerOp floating point operations each
+        template<class Op>
+        Result* run(std::string_view name, int opsPerCall, double flopsPerOp, Op&& op)
+        {
+            if(!enabled(name))
+                return nullptr;
+
+            using Clock = std::chrono::steady_clock;
+            auto timeCalls = [&](uint64_t numCalls) {
+                const auto start = Clock::now();
+                for(uint64_t i = 0; i < numCalls; ++i)
+                    op();
+                return std::chrono::duration<double>(Clock::now() - start).count();
+            };
+
+            // Warm up caches and branch predictors, then grow the batch until one repetition takes long enough
+            const double repetitionTime = minTime / repetitions;
+            uint64_t numCalls = 1;
+            double elapsed = timeCalls(numCalls);
+            while(elapsed < repetitionTime)
+            {
+                const double scale = elapsed > 0 ? std::min(10.0, 1.5 * repetitionTime / elapsed) : 10.0;
+                numCalls = std::max(numCalls + 1, uint64_t(double(numCalls) * scale));
+                elapsed = timeCalls(numCalls);
+            }
+
+            std::vector<double> nsPerOp(repetitions);
+            const double numOps = double(numCalls) * opsPerCall;
+            for(auto& sample : nsPerOp)
+                sample = timeCalls(numCalls) * 1e9 / numOps;
+            std::sort(nsPerOp.begin(), nsPerOp.end());
+
+            Result& result = m_results.emplace_back();
+            result.name = name;
+            result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+            result.nsPerOpMin = nsPerOp.front();
+            result.flopsPerOp = flopsPerOp;
+            result.numOps = uint64_t(numOps) * repetitions;
+            return &result;
+        }
+
+        const std::vector<Result>& results() const { return m_results; }
+
+    private:
+        std::vector<Result> m_results;
+    };
+}
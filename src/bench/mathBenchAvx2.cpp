@@ -0,0 +1,66 @@
+// Molecular dynamics playground
+// SIMD math benchmark kernels. float4 shuffles and float8 need AVX2 and FMA, so this unit is built with them enabled
+// and only called when the CPU supports them. Inputs, timing and results live in mdBench.cpp.
+#include "mathBenchAvx2.h"
+
+#include <math/vectorFloat.h>
+
+using namespace math;
+
+namespace bench
+{
+    namespace
+    {
+        template<class Pack>
+        void mulAdd(const float* a, const float* b, const float* c, float* out, int n)
+        {
+            for(int i = 0; i < n; i += Pack::Width)
+                Pack::load(&a[i]).mul_add(Pack::load(&b[i]), Pack::load(&c[i])).store(&out[i]);
+        }
+
+        template<class Pack>
+        void div(const float* a, const float* b, float* out, int n)
+        {
+            for(int i = 0; i < n; i += Pack::Width)
+                (Pack::load(&a[i]) / Pack::load(&b[i])).store(&out[i]);
+        }
+
+        template<class Pack>
+        void squareRoot(const float* a, float* out, int n)
+        {
+            for(int i = 0; i < n; i += Pack::Width)
+                sqrt(Pack::load(&a[i])).store(&out[i]);
+        }
+
+        template<class Pack>
+        float hSum(const float* a, int n)
+        {
+            float sum = 0;
+            for(int i = 0; i < n; i += Pack::Width)
+                sum += Pack::load(&a[i]).hSum();
+            return sum;
+        }
+
+        template<class Pack>
+        PackKernels packKernels()
+        {
+            return { mulAdd<Pack>, div<Pack>, squareRoot<Pack>, hSum<Pack> };
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    PackKernels float4Kernels() { return packKernels<float4>(); }
+    PackKernels float8Kernels() { return packKernels<float8>(); }
+
+    //----------------------------------------------------------------------------------------------
+    int countHitsSimd(const AABB& box, const Ray::ImplicitSimd* rays, int n, float tMax)
+    {
+        const AABBSimd boxSimd(box.min(), box.max());
+        const float4 tMaxSimd(tMax);
+        int hits = 0;
+        float t;
+        for(int i = 0; i < n; ++i)
+            hits += boxSimd.intersect(rays[i], tMaxSimd, t);
+        return hits;
+    }
+}
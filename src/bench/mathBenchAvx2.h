@@ -0,0 +1,26 @@
+// Molecular dynamics playground
+// SIMD math kernels timed by md_bench. Implemented in mathBenchAvx2.cpp, built with AVX2 and FMA enabled:
+// only call them when the CPU supports both.
+// That unit holds nothing but pack and AABB code, so it emits no library symbols (containers, generators, strings)
+// that the rest of md_bench shares and could end up linking to their AVX2 copies.
+#pragma once
+
+#include <math/aabb.h>
+
+namespace bench
+{
+    // Element-wise loops over n floats, a multiple of the pack width, in packs of float4 or float8
+    struct PackKernels
+    {
+        void (*mulAdd)(const float* a, const float* b, const float* c, float* out, int n);
+        void (*div)(const float* a, const float* b, float* out, int n);
+        void (*sqrt)(const float* a, float* out, int n);
+        float (*hSum)(const float* a, int n);
+    };
+
+    PackKernels float4Kernels();
+    PackKernels float8Kernels();
+
+    // Number of rays hitting box within tMax, with AABBSimd
+    int countHitsSimd(const math::AABB& box, const math::Ray::ImplicitSimd* rays, int n, float tMax);
+}
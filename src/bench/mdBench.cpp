@@ -0,0 +1,342 @@
+// Molecular dynamics playground
+// Benchmark suite for the math and physics kernels. Prints results as JSON, to track regressions across commits.
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include "benchmark.h"
+#include "cmdLineParser.h"
+#include "mathBenchAvx2.h"
+#include <math/matrix.h>
+#include <math/vector.h>
+#include <md/argonSimulation.h>
+#include <orbits.h>
+
+using namespace math;
+
+namespace
+{
+    constexpr int BatchSize = 512;
+
+    // Approximate flops per Verlet list entry in the pair kernel: minimum image (15), r^2 (5),
+    // LJ force (8), force accumulation (6), energy (5) and virial (2). Entries beyond the cutoff are evaluated and masked.
+    constexpr double FlopsPerListEntry = 41;
+
+    template<class T>
+    std::vector<Vector<T, 3>> randomVectors(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<T> dist(T(-1), T(1));
+        std::vector<Vector<T, 3>> v(BatchSize);
+        for(auto& x : v)
+            x = Vector<T, 3>(dist(rng), dist(rng), dist(rng));
+        return v;
+    }
+
+    void runVectorBenchmarks(bench::Runner& runner)
+    {
+        std::mt19937 rng(42);
+        const auto af = randomVectors<float>(rng);
+        const auto bf = randomVectors<float>(rng);
+        const auto ad = randomVectors<double>(rng);
+        const auto bd = randomVectors<double>(rng);
+        std::vector<Vec3f> outf(BatchSize);
+        std::vector<Vec3d> outd(BatchSize);
+
+        runner.run("Vec3f.add", BatchSize, 3, [&]() {
+            for(int i = 0; i < BatchSize; ++i)
+                outf[i] = af[i] + bf[i];
+            bench::clobberMemory();
+        });
+        runner.run("Vec3f.dot", BatchSize, 5, [&]() {
+            float sum = 0;
+            for(int i = 0; i < BatchSize; ++i)
+                sum += dot(af[i], bf[i]);
+            bench::doNotOptimize(sum);
+        });
+        runner.run("Vec3d.add", BatchSize, 3, [&]() {
+            for(int i = 0; i < BatchSize; ++i)
+                outd[i] = ad[i] + bd[i];
+            bench::clobberMemory();
+        });
+        runner.run("Vec3d.cross", BatchSize, 9, [&]() {
+            for(int i = 0; i < BatchSize; ++i)
+                outd[i] = cross(ad[i], bd[i]);
+            bench::clobberMemory();
+        });
+        runner.run("Vec3d.normalize", BatchSize, 10, [&]() {
+            for(int i = 0; i < BatchSize; ++i)
+                outd[i] = normalize(ad[i]);
+            bench::clobberMemory();
+        });
+    }
+
+    // Pack arithmetic of one width, from the AVX2 unit
+    void runPackBenchmarks(bench::Runner& runner, const char* name, int width, const bench::PackKernels& kernels)
+    {
+        alignas(64) std::array<float, BatchSize> a, b, c, out;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> dist(0.5f, 2.f);
+        for(int i = 0; i < BatchSize; ++i)
+        {
+            a[i] = dist(rng);
+            b[i] = dist(rng);
+            c[i] = dist(rng);
+        }
+
+        runner.run(std::string(name) + ".mul_add", BatchSize / width, 2 * width, [&]() {
+            kernels.mulAdd(a.data(), b.data(), c.data(), out.data(), BatchSize);
+            bench::clobberMemory();
+        });
+        runner.run(std::string(name) + ".div", BatchSize / width, width, [&]() {
+            kernels.div(a.data(), b.data(), out.data(), BatchSize);
+            bench::clobberMemory();
+        });
+        runner.run(std::string(name) + ".sqrt", BatchSize / width, width, [&]() {
+            kernels.sqrt(a.data(), out.data(), BatchSize);
+            bench::clobberMemory();
+        });
+        runner.run(std::string(name) + ".hSum", BatchSize / width, width - 1, [&]() {
+            float sum = kernels.hSum(a.data(), BatchSize);
+            bench::doNotOptimize(sum);
+        });
+    }
+
+    void runAabbBenchmarks(bench::Runner& runner)
+    {
+        // Unit box at the origin, rays from random points around it towards random points inside it,
+        // so roughly half of them hit
+        const AABB box(Vec3f(-0.5f, -0.5f, -0.5f), Vec3f(0.5f, 0.5f, 0.5f));
+        std::vector<Ray::Implicit> implicitRays;
+        std::vector<Ray::ImplicitSimd> simdRays;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        for(int i = 0; i < BatchSize; ++i)
+        {
+            const Vec3f origin(4 * dist(rng), 4 * dist(rng), 4 * dist(rng));
+            const Vec3f target(dist(rng), dist(rng), dist(rng));
+            const Ray ray(origin, normalize(target - origin));
+            implicitRays.push_back(ray.implicit());
+            simdRays.push_back(ray.implicitSimd());
+        }
+
+        // Intersection tests are mostly compares and selects, so no flop count is reported
+        runner.run("AABB.intersect", BatchSize, 0, [&]() {
+            int hits = 0;
+            float t;
+            for(auto& ray : implicitRays)
+                hits += box.intersect(ray, 100.f, t);
+            bench::doNotOptimize(hits);
+        });
+        runner.run("AABBSimd.intersect", BatchSize, 0, [&]() {
+            int hits = bench::countHitsSimd(box, simdRays.data(), BatchSize, 100.f);
+            bench::doNotOptimize(hits);
+        });
+    }
+
+    // float4 shuffles and float8 need AVX2 and FMA. Only the loops are built with them, see mathBenchAvx2.h.
+    void runSimdMathBenchmarks(bench::Runner& runner)
+    {
+        runPackBenchmarks(runner, "float4", 4, bench::float4Kernels());
+        runPackBenchmarks(runner, "float8", 8, bench::float8Kernels());
+        runAabbBenchmarks(runner);
+    }
+
+    void runMatrixBenchmarks(bench::Runner& runner)
+    {
+        // Diagonally dominant, so every factorization is well conditioned
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        std::vector<Matrix44f> matrices(BatchSize);
+        for(auto& m : matrices)
+        {
+            for(int i = 0; i < 4; ++i)
+                for(int j = 0; j < 4; ++j)
+                    m(i, j) = dist(rng) + (i == j ? 4.f : 0.f);
+        }
+
+        // 4x4 Gaussian elimination: sum over k of (3-k) rows of one division and (3-k) multiply-subtracts
+        runner.run("Matrix44f.factorizationLU", BatchSize, 34, [&]() {
+            Matrix44f L, U;
+            std::array<int, 4> P;
+            for(auto& m : matrices)
+            {
+                m.factorizationLU(L, U, P);
+                bench::doNotOptimize(U);
+            }
+        });
+    }
+
+    void runOrbitBenchmarks(bench::Runner& runner)
+    {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> days(0, 20 * 365);
+        std::vector<TimePoint> times(BatchSize);
+        for(auto& t : times)
+            t = J2000 + std::chrono::days(days(rng));
+
+        runner.run("ConicOrbit.TrueAnomaly", BatchSize, 0, [&]() {
+            double sum = 0;
+            for(auto& t : times)
+                sum += EarthOrbit.TrueAnomaly(t);
+            bench::doNotOptimize(sum);
+        });
+    }
+
+    // Full simulation steps at liquid density (0.8 atoms per sigma^3), melting from an FCC lattice
+    void runSimulationBenchmarks(bench::Runner& runner, const md::ArgonSimulation::Config& baseConfig, int maxAtoms)
+    {
+        constexpr double Density = 0.8;
+        constexpr double Temperature = 1.0;
+        constexpr int WarmUpSteps = 10;
+        for(int numAtoms : { 1000, 10000, 100000 })
+        {
+            const std::string name = "ArgonSimulation.step/" + std::to_string(numAtoms);
+            if(numAtoms > maxAtoms || !runner.enabled(name))
+                continue;
+
+            auto config = baseConfig;
+            config.numAtoms = numAtoms;
+            config.density = Density;
+            config.initialPositions = md::ArgonSimulation::InitialPositions::FCC;
+            config.initialTemperature = Temperature;
+            md::ArgonSimulation sim(config);
+            for(int i = 0; i < WarmUpSteps; ++i)
+                sim.step();
+
+            sim.neighbors().resetStats();
+            const uint64_t warmUpRebuilds = sim.domains() ? sim.domains()->numRebuilds() : 0;
+            uint64_t numSteps = 0;
+            auto* result = runner.run(name, 1, 0, [&]() {
+                sim.step();
+                ++numSteps;
+            });
+
+            result->numAtoms = numAtoms;
+            result->atomStepsPerSecond = numAtoms * 1e9 / result->nsPerOp;
+            if(sim.usesNeighborList())
+            {
+                const auto& neighbors = sim.neighbors();
+                result->flopsPerOp = neighbors.averageListLength() * numAtoms * FlopsPerListEntry;
+                result->listRebuildsPerStep = double(neighbors.numBuilds()) / double(numSteps);
+            }
+            else if(const md::DomainDecomposition* domains = sim.domains())
+            {
+                result->flopsPerOp = domains->averageListLength() * numAtoms * FlopsPerListEntry;
+                result->listRebuildsPerStep = double(domains->numRebuilds() - warmUpRebuilds) / double(numSteps);
+            }
+        }
+    }
+
+    std::string escapeJson(const std::string& s)
+    {
+        std::string escaped;
+        for(char c : s)
+        {
+            if(c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    void writeJson(FILE* out, const bench::Runner& runner, const md::ArgonSimulation::Config& config)
+    {
+        std::fprintf(out, "{\n");
+        std::fprintf(out, "  \"context\": {\n");
+#if defined(__clang__)
+        std::fprintf(out, "    \"compiler\": \"clang %s\",\n", __clang_version__);
+#elif defined(__GNUC__)
+        std::fprintf(out, "    \"compiler\": \"gcc %s\",\n", __VERSION__);
+#elif defined(_MSC_VER)
+        std::fprintf(out, "    \"compiler\": \"msvc %d\",\n", _MSC_FULL_VER);
+#endif
+        std::fprintf(out, "    \"simd\": \"%s\",\n", md::simdLevelName(config.simdLevel));
+        std::fprintf(out, "    \"precision\": \"%s\",\n", md::pairPrecisionName(config.precision));
+        std::fprintf(out, "    \"respa_steps\": %d,\n", std::max(1, config.respaSteps));
+        std::fprintf(out, "    \"threads\": %d\n", config.forceBackend != md::ArgonSimulation::ForceBackend::VerletList ? config.numThreads : 1);
+        std::fprintf(out, "  },\n");
+        std::fprintf(out, "  \"benchmarks\": [");
+        const auto& results = runner.results();
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            std::fprintf(out, "%s\n    {\"name\": \"%s\", \"ns_per_op\": %.6g, \"ns_per_op_min\": %.6g, \"ops\": %llu",
+                i ? "," : "", escapeJson(r.name).c_str(), r.nsPerOp, r.nsPerOpMin, (unsigned long long)r.numOps);
+            if(r.flopsPerOp > 0)
+                std::fprintf(out, ", \"gflops\": %.6g", r.gflops());
+            if(r.numAtoms > 0)
+            {
+                std::fprintf(out, ", \"atoms\": %d, \"atom_steps_per_s\": %.6g, \"list_rebuilds_per_step\": %.4g",
+                    r.numAtoms, r.atomStepsPerSecond, r.listRebuildsPerStep);
+            }
+            std::fprintf(out, "}");
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    bench::Runner runner;
+    md::ArgonSimulation::Config config;
+    config.forceBackend = md::ArgonSimulation::ForceBackend::VerletList;
+    int maxAtoms = 100000;
+    std::string outPath;
+    bool threaded = false;
+    bool domains = false;
+    bool singlePrecision = false;
+    std::string precisionName;
+
+    CmdLineParser parser;
+    parser.addOption("min-time", &runner.minTime);
+    parser.addOption("repetitions", &runner.repetitions);
+    parser.addOption("filter", &runner.filter);
+    parser.addOption("max-atoms", &maxAtoms);
+    parser.addOption("threads", &config.numThreads);
+    parser.addOption("respa", &config.respaSteps);
+    parser.addOption("dt", &config.timeStep);
+    parser.addOption("out", &outPath);
+    parser.addFlag("threaded", threaded);
+    parser.addFlag("domains", domains);
+    parser.addFlag("pin", config.pinThreads);
+    parser.addFlag("float", singlePrecision);
+    parser.addOption("precision", &precisionName);
+    parser.parse(argc, argv);
+
+    if(threaded)
+        config.forceBackend = md::ArgonSimulation::ForceBackend::Threaded;
+    if(domains)
+        config.forceBackend = md::ArgonSimulation::ForceBackend::Domains;
+    if(singlePrecision)
+        config.precision = md::PairPrecision::Single;
+    if(!precisionName.empty() && !md::parsePairPrecision(precisionName, config.precision))
+    {
+        std::fprintf(stderr, "Unknown precision: %s\n", precisionName.c_str());
+        return -1;
+    }
+    runner.repetitions = std::max(1, runner.repetitions);
+
+    runVectorBenchmarks(runner);
+    if(md::detectSimdLevel() >= md::SimdLevel::AVX2)
+        runSimdMathBenchmarks(runner);
+    runMatrixBenchmarks(runner);
+    runOrbitBenchmarks(runner);
+    runSimulationBenchmarks(runner, config, maxAtoms);
+
+    FILE* out = stdout;
+    if(!outPath.empty())
+    {
+        out = std::fopen(outPath.c_str(), "w");
+        if(!out)
+        {
+            std::fprintf(stderr, "Can't open %s\n", outPath.c_str());
+            return -1;
+        }
+    }
+    writeJson(out, runner, config);
+    if(out != stdout)
+        std::fclose(out);
+    return 0;
+}
@@ -2,199 +2,206 @@
 
 #include "imgui.h"
 #include "implot.h"
-#include <cmath>
+#include <thread>
+#include <vector>
 #include "app.h"
-#include <math/vector.h>
-#include <numbers>
-#include <random>
+#include <md/argonSimulation.h>
 
-static constexpr auto Pi = std::numbers::pi_v<double>;
-static constexpr auto TwoPi = 2 * std::numbers::pi_v<double>;
-
-using namespace math;
-
-class ArgonSimulation : public App
+class ArgonViewer : public App
 {
 public:
     bool show = true;
-    bool freeze = true;
-    ArgonSimulation()
+    ArgonViewer()
     {
-        // Init the simulation pool
-        scatterParticles();
+        // Start frozen, so the scatter can be inspected before it runs
+        m_sim.config.freeze = true;
     }
 
     void update() override
     {
+        auto& config = m_sim.config;
         // Update simulation
-        step();
+        m_sim.step();
         // Plot state
         if(ImGui::Begin("particles"))
         {
             if (ImGui::Button("Scatter"))
             {
-                scatterParticles();
+                m_sim.scatterParticles();
             }
-            ImGui::Checkbox("Freeze", &freeze);
-            drawParticles(m_particles);
-        }
-        ImGui::End();
-    }
-
-private:
-    struct AtomBuffer
-    {
-        AtomBuffer()
-        {
-            pos = new Vec3d[N];
-            vel = new Vec3d[N];
-            acc = new Vec3d[N];
-
-            for(int i = 0; i < N; ++i)
+            int numAtoms = m_sim.numAtoms();
+            if(ImGui::SliderInt("Atoms", &numAtoms, 2, 2000, "%d", ImGuiSliderFlags_Logarithmic))
+                m_sim.resize(numAtoms);
+            ImGui::Checkbox("Freeze", &config.freeze);
+            ImGui::Checkbox("Periodic", &config.periodic);
+            ImGui::Combo("Force backend", reinterpret_cast<int*>(&config.forceBackend), "Brute force\0Cell list\0Verlet list\0Threaded\0Domains\0");
+            ImGui::SliderFloat("Cutoff", &config.cutoff, 1.f, float(m_sim.box().size / 2));
+            ImGui::Checkbox("Shifted force", &config.shiftedForce);
+            ImGui::Combo("Thermostat", reinterpret_cast<int*>(&config.thermostat), "None\0Berendsen\0Nose-Hoover chain\0Langevin\0");
+            if(config.thermostat != md::ThermostatKind::None)
             {
-                vel[i] = Vec3d{0,0,0};
-                acc[i] = Vec3d{0,0,0};
+                auto& params = config.thermostatParams;
+                float temperature = float(params.temperature);
+                if(ImGui::SliderFloat("Temperature", &temperature, 0.01f, 5.f))
+                    params.temperature = temperature;
+                if(config.thermostat == md::ThermostatKind::Langevin)
+                {
+                    float friction = float(params.friction);
+                    if(ImGui::SliderFloat("Friction", &friction, 0.01f, 10.f, "%.3f", ImGuiSliderFlags_Logarithmic))
+                        params.friction = friction;
+                }
+                else
+                {
+                    float tau = float(params.tau);
+                    if(ImGui::SliderFloat("Coupling time", &tau, 0.01f, 10.f, "%.3f", ImGuiSliderFlags_Logarithmic))
+                        params.tau = tau;
+                }
             }
+            ImGui::Text("Temperature: %.3f", m_sim.temperature());
+            ImGui::Combo("Barostat", reinterpret_cast<int*>(&config.barostat), "None\0Berendsen\0MTK\0");
+            if(config.barostat != md::BarostatKind::None)
+            {
+                auto& params = config.barostatParams;
+                float pressure = float(params.pressure);
+                if(ImGui::SliderFloat("Target pressure", &pressure, 0.f, 10.f))
+                    params.pressure = pressure;
+                float tau = float(params.tau);
+                if(ImGui::SliderFloat("Pressure coupling time", &tau, 0.1f, 100.f, "%.3f", ImGuiSliderFlags_Logarithmic))
+                    params.tau = tau;
+            }
+            ImGui::Text("Pressure: %.3f, box: %.3f, density: %.4f", m_sim.pressure(), m_sim.boxSize(), m_sim.numAtoms() / m_sim.volume());
+            const bool domains = config.forceBackend == md::ArgonSimulation::ForceBackend::Domains;
+            if(m_sim.usesNeighborList() || domains)
+            {
+                if(config.forceBackend == md::ArgonSimulation::ForceBackend::Threaded || domains)
+                    ImGui::SliderInt("Threads", &config.numThreads, 1, int(std::thread::hardware_concurrency()));
+                if(ImGui::BeginCombo("SIMD", md::simdLevelName(config.simdLevel)))
+                {
+                    for(int level = 0; level <= int(m_maxSimdLevel); ++level)
+                    {
+                        if(ImGui::Selectable(md::simdLevelName(md::SimdLevel(level)), level == int(config.simdLevel)))
+                            config.simdLevel = md::SimdLevel(level);
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::Combo("Precision", reinterpret_cast<int*>(&config.precision), "Double\0Single\0Mixed\0");
+                ImGui::SliderFloat("Skin", &config.skin, 0.05f, 1.f);
+            }
+            if(domains)
+            {
+                ImGui::Checkbox("Pin threads", &config.pinThreads);
+                if(const md::DomainDecomposition* decomposition = m_sim.domains())
+                {
+                    const auto& grid = decomposition->grid();
+                    ImGui::Text("Domains: %d x %d x %d", grid[0], grid[1], grid[2]);
+                    ImGui::Text("Rebuilds: %llu, migrations: %llu", (unsigned long long)decomposition->numRebuilds(),
+                        (unsigned long long)decomposition->numMigrations());
+                    ImGui::Text("Ghosts per owned atom: %.2f", decomposition->ghostRatio());
+                    if(decomposition->numUnpinned() > 0)
+                        ImGui::Text("Unpinned threads: %d", decomposition->numUnpinned());
+                }
+            }
+            if(m_sim.usesNeighborList())
+            {
+                auto& neighbors = m_sim.neighbors();
+                ImGui::SliderInt("Reorder interval", &config.reorderInterval, 0, 1000);
+                ImGui::Combo("Reorder curve", reinterpret_cast<int*>(&config.reorderCurve), "Morton\0Hilbert\0");
+                ImGui::SliderInt("RESPA inner steps", &config.respaSteps, 1, 8);
+                if(config.respaSteps > 1)
+                {
+                    ImGui::SliderFloat("RESPA split", &config.respaCutoff, 1.f, config.cutoff);
+                    ImGui::SliderFloat("RESPA switch width", &config.respaSwitch, 0.05f, 1.f);
+                }
+                ImGui::Text("List rebuilds: %llu", (unsigned long long)neighbors.numBuilds());
+                ImGui::Text("Avg. neighbors per atom: %.2f", neighbors.averageListLength());
+                if(ImGui::Button("Reset stats"))
+                    neighbors.resetStats();
+            }
+            if(ImGui::CollapsingHeader("Radial distribution"))
+            {
+                ImGui::SliderInt("Sample interval", &config.rdfInterval, 0, 100);
+                ImGui::SliderInt("Bins", &config.rdfBins, 10, 500);
+                auto& rdf = m_sim.radialDistribution();
+                ImGui::Text("Samples: %llu", (unsigned long long)rdf.numSamples());
+                ImGui::SameLine();
+                if(ImGui::Button("Clear"))
+                    rdf.clear();
+                drawRadialDistribution(rdf);
+            }
+            drawParticles(m_sim.particles());
         }
-        ~AtomBuffer()
-        {
-            delete[] pos;
-            delete[] vel;
-            delete[] acc;
-        }
-
-        Vec3d* pos = nullptr;
-        Vec3d* vel = nullptr;
-        Vec3d* acc = nullptr;
-
-        static constexpr auto N = 15;
-    } m_particles;
-
-    static constexpr double BoxSize = 10.f;
-
-    void scatterParticles()
-    {
-        for(int i = 0; i < AtomBuffer::N; ++i)
-        {
-            m_particles.pos[i] = noise3d();
-        }
-    }
+        ImGui::End();
 
-    void step()
-    {
-        constexpr auto h = 5e-3; // Dimensionless time step
-        // Update positions
-        if(!freeze)
-            updatePositions(h);
-        // Compute accelerations
-        computeAccelerations();
-        // Update speeds
-        updateSpeeds(h);
+        drainObservables();
+        if(ImGui::Begin("energy"))
+            drawEnergy();
+        ImGui::End();
     }
 
-    void drawParticles(AtomBuffer& particles)
-    {
-        ImPlot::BeginPlot("Simulation", ImVec2(-1, -1), ImPlotFlags_Equal);
-        ImPlot::PlotScatter("Atoms", &particles.pos[0].x(), &particles.pos[0].y(), AtomBuffer::N, 0, sizeof(Vec3d));
-        ImPlot::EndPlot();
-    }
+private:
+    md::ArgonSimulation m_sim;
+    const md::SimdLevel m_maxSimdLevel = md::detectSimdLevel();
 
-    void updatePositions(double h)
-    {
-        for(int i = 0; i < AtomBuffer::N; ++i)
-        {
-            auto& pos = m_particles.pos[i];
-            pos += (m_particles.vel[i] + 0.5 * m_particles.acc[i] * h) * h;
-            constexpr double halfBoxSize = BoxSize / 2;
-            // Keep it in the box
-            Vec3d normPos = (pos + halfBoxSize) / BoxSize;
-            Vec3d delta = Vec3d(std::floor(normPos.x()), std::floor(normPos.y()), std::floor(normPos.z()));
-            pos = (normPos - delta) * BoxSize - halfBoxSize;
-        }
-    }
+    // Most recent samples of the observables, oldest first
+    static constexpr size_t HistorySize = 1000;
+    std::vector<double> m_time;
+    std::vector<double> m_kinetic;
+    std::vector<double> m_potential;
+    std::vector<double> m_total;
 
-    void computeAccelerations()
+    void drainObservables()
     {
-        // Clear previous accelerations
-        for(int i = 0; i < AtomBuffer::N; ++i)
+        md::Observables o;
+        while(m_sim.observables().pop(o))
         {
-            m_particles.acc[i] = Vec3d{0,0,0};
-        }
-
-        // Iterate over every particle pair
-        // TODO:
-        // Add periodic boundary conditions
-        // Add cut off radius
-        for(int i = 0; i < AtomBuffer::N; ++i)
-        {
-            for(int j = 0; j < i; ++j)
+            if(m_time.size() == HistorySize)
             {
-                // Compute the force exerted by j into i
-                //for(int k = 0; k < 27; ++k)
-                //{ }
-                auto xij = m_particles.pos[j] - m_particles.pos[i];
-                auto inv_rij2 = 1/dot(xij, xij);
-                auto inv_rij6 = inv_rij2 * inv_rij2 * inv_rij2;
-                auto inv_rij12 = inv_rij6 * inv_rij6;
-                auto f = 4*(12*inv_rij12 - 6*inv_rij6)*inv_rij2*xij;
-                // Using adimensional units, f=a for the particles because m=1;
-                m_particles.acc[i] -= f;
-                m_particles.acc[j] += f;
+                for(auto* series : { &m_time, &m_kinetic, &m_potential, &m_total })
+                    series->erase(series->begin());
             }
+            m_time.push_back(o.time);
+            m_kinetic.push_back(o.kineticEnergy);
+            m_potential.push_back(o.potentialEnergy);
+            m_total.push_back(o.totalEnergy() + o.extendedEnergy);
         }
     }
 
-    void updateSpeeds(double h)
+    void drawEnergy()
     {
-        for(int i = 0; i < AtomBuffer::N; ++i)
+        if(ImPlot::BeginPlot("Energy", ImVec2(-1, -1)))
         {
-            m_particles.vel[i] += h*m_particles.acc[i];
+            ImPlot::SetupAxes("Time", "Energy", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            const int count = int(m_time.size());
+            ImPlot::PlotLine("Kinetic", m_time.data(), m_kinetic.data(), count);
+            ImPlot::PlotLine("Potential", m_time.data(), m_potential.data(), count);
+            ImPlot::PlotLine("Total", m_time.data(), m_total.data(), count);
+            ImPlot::EndPlot();
         }
     }
 
-    static int squirrelNoise(int position, int seed = 0)
+    void drawRadialDistribution(md::RadialDistribution& rdf)
     {
-        constexpr unsigned int BIT_NOISE1 = 0xB5297A4D;
-        constexpr unsigned int BIT_NOISE2 = 0x68E31DA4;
-        constexpr unsigned int BIT_NOISE3 = 0x1B56C4E9;
-
-        int mangled = position;
-        mangled *= BIT_NOISE1;
-        mangled += seed;
-        mangled ^= (mangled >> 8);
-        mangled *= BIT_NOISE2;
-        mangled ^= (mangled << 8);
-        mangled *= BIT_NOISE3;
-        mangled ^= (mangled >> 8);
-        return mangled;
-    }
-
-    struct squirrelRng
-    {
-        int rand()
+        if(ImPlot::BeginPlot("g(r)", ImVec2(-1, 200)))
         {
-            return squirrelNoise(state++);
+            ImPlot::SetupAxes("r", "g(r)", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            if(rdf.numSamples() > 0)
+                ImPlot::PlotLine("g(r)", rdf.radii().data(), rdf.values().data(), rdf.numBins());
+            ImPlot::EndPlot();
         }
+    }
 
-        int state = 0;
-    } m_rng;
-
-    Vec3d noise3d()
+    void drawParticles(const md::AtomBuffer& particles)
     {
-        Vec3d result;
-        auto k = 0xffffff; // 2e24
-        auto r = m_rng.rand();
-        result.x() = double(r%k)/k*BoxSize-(BoxSize/2);
-        result.y() = double(m_rng.rand()%k)/k*BoxSize-(BoxSize/2);
-        result.z() = double(m_rng.rand()%k)/k*BoxSize-(BoxSize/2);
-        return result;
+        ImPlot::BeginPlot("Simulation", ImVec2(-1, -1), ImPlotFlags_Equal);
+        ImPlot::PlotScatter("Atoms", particles.pos.x, particles.pos.y, particles.size(), 0, md::Vec3Stream::Stride);
+        ImPlot::EndPlot();
     }
 };
 
 // Main code
 int main(int, char**)
 {
-    ArgonSimulation app;
+    ArgonViewer app;
     if (!app.init())
         return -1;
 
@@ -20,10 +20,13 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <initializer_list>
 #include "aabb.h"
 
+#ifdef _WIN32
 #include <DirectXMath.h>
+#endif
 
 namespace math
 {
@@ -181,6 +184,7 @@ namespace math
 			memcpy(m, colMajorArray.data(), sizeof(Matrix44f));
 		}
 
+#ifdef _WIN32
 		explicit Matrix44f(const DirectX::XMMATRIX& rowMajorMtx)
 		{
 			auto& colMajor = reinterpret_cast<DirectX::XMMATRIX&>(*this);
@@ -193,6 +197,7 @@ namespace math
 			// Col-Major to Row-Major
 			return DirectX::XMMatrixTranspose(colMajor);
 		}
+#endif
 
 		static auto lowSolve(const Matrix44f& L, const Vec4f& y)
 		{
@@ -22,7 +22,16 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <random>
+#if defined(__SSE2__) || defined(_M_X64)
+#define MATH_RANDOM_SSE2
+#include <emmintrin.h>
+#endif
 #include "constants.h"
 #include "vector.h"
 
@@ -48,3 +57,316 @@ private:
 	std::default_random_engine engine;
 	std::uniform_real_distribution<float> distrib;
 };
+
+namespace math
+{
+	//-----------------------------------------------------------------
+	// Philox4x32-10 block transform (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC11).
+	// Maps a 128 bit counter and a 64 bit key to 128 random bits, in place.
+	// Branch free and only uses 32x32->64 multiplies, so loops over many counters vectorize.
+	inline void philox4x32(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1)
+	{
+		constexpr uint32_t M0 = 0xD2511F53;
+		constexpr uint32_t M1 = 0xCD9E8D57;
+		constexpr uint32_t W0 = 0x9E3779B9;
+		constexpr uint32_t W1 = 0xBB67AE85;
+		for(int round = 0; round < 10; ++round)
+		{
+			const uint64_t p0 = uint64_t(M0) * c0;
+			const uint64_t p1 = uint64_t(M1) * c2;
+			const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+			const uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+			c1 = uint32_t(p1);
+			c3 = uint32_t(p0);
+			c0 = n0;
+			c2 = n2;
+			k0 += W0;
+			k1 += W1;
+		}
+	}
+
+#ifdef MATH_RANDOM_SSE2
+	//-----------------------------------------------------------------
+	// Four Philox blocks at once, one per 32 bit lane. SSE2 only, so it's available on every x86-64 target
+	// and doesn't depend on the compiler vectorizing the scalar version.
+	inline void philox4x32(__m128i& c0, __m128i& c1, __m128i& c2, __m128i& c3, uint32_t key0, uint32_t key1)
+	{
+		const __m128i m0 = _mm_set1_epi32(int(0xD2511F53));
+		const __m128i m1 = _mm_set1_epi32(int(0xCD9E8D57));
+		const __m128i loMask = _mm_set1_epi64x(0xffffffff);
+		// Full 64 bit products of each lane, split into low and high halves
+		auto mulhilo = [&](__m128i a, __m128i m, __m128i& lo, __m128i& hi) {
+			const __m128i even = _mm_mul_epu32(a, m); // Lanes 0 and 2
+			const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m); // Lanes 1 and 3
+			lo = _mm_or_si128(_mm_and_si128(even, loMask), _mm_slli_epi64(odd, 32));
+			hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(loMask, odd));
+		};
+		for(int round = 0; round < 10; ++round)
+		{
+			__m128i lo0, hi0, lo1, hi1;
+			mulhilo(c0, m0, lo0, hi0);
+			mulhilo(c2, m1, lo1, hi1);
+			const __m128i k0 = _mm_set1_epi32(int(key0));
+			const __m128i k1 = _mm_set1_epi32(int(key1));
+			c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), k0);
+			c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), k1);
+			c1 = lo1;
+			c3 = lo0;
+			key0 += 0x9E3779B9;
+			key1 += 0xBB67AE85;
+		}
+	}
+#endif
+
+	namespace detail
+	{
+		//-----------------------------------------------------------------
+		// Lanes of the Box-Muller transform: plain doubles, and SSE2 pairs where available.
+		// Both only use exactly rounded operations (+, -, *, /, sqrt), compares and bit manipulation,
+		// so a deviate has the same bits whichever path computes it.
+		inline bool greaterEqual(double a, double b) { return a >= b; }
+		inline bool equal(double a, double b) { return a == b; }
+		inline bool either(bool a, bool b) { return a || b; }
+		inline double select(bool mask, double a, double b) { return mask ? a : b; }
+		inline double squareRoot(double a) { return std::sqrt(a); }
+
+		// x = m 2^e for positive normal x, with m in [1, 2)
+		inline void splitExponent(double x, double& e, double& m)
+		{
+			uint64_t bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+			e = double(int(bits >> 52) - 1023);
+			bits = (bits & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+			std::memcpy(&m, &bits, sizeof(m));
+		}
+
+#ifdef MATH_RANDOM_SSE2
+		struct double2Lanes
+		{
+			double2Lanes() = default;
+			explicit double2Lanes(double x) : m(_mm_set1_pd(x)) {}
+			explicit double2Lanes(__m128d x) : m(x) {}
+
+			double2Lanes operator+(double2Lanes b) const { return double2Lanes(_mm_add_pd(m, b.m)); }
+			double2Lanes operator-(double2Lanes b) const { return double2Lanes(_mm_sub_pd(m, b.m)); }
+			double2Lanes operator*(double2Lanes b) const { return double2Lanes(_mm_mul_pd(m, b.m)); }
+			double2Lanes operator/(double2Lanes b) const { return double2Lanes(_mm_div_pd(m, b.m)); }
+
+			__m128d m;
+		};
+
+		inline __m128d greaterEqual(double2Lanes a, double2Lanes b) { return _mm_cmpge_pd(a.m, b.m); }
+		inline __m128d equal(double2Lanes a, double2Lanes b) { return _mm_cmpeq_pd(a.m, b.m); }
+		inline __m128d either(__m128d a, __m128d b) { return _mm_or_pd(a, b); }
+		inline double2Lanes select(__m128d mask, double2Lanes a, double2Lanes b)
+		{
+			return double2Lanes(_mm_or_pd(_mm_and_pd(mask, a.m), _mm_andnot_pd(mask, b.m)));
+		}
+		inline double2Lanes squareRoot(double2Lanes a) { return double2Lanes(_mm_sqrt_pd(a.m)); }
+
+		// The biased exponent goes into the mantissa of 2^52, which turns it into a double without 64 bit conversions
+		inline void splitExponent(double2Lanes x, double2Lanes& e, double2Lanes& m)
+		{
+			const __m128i bits = _mm_castpd_si128(x.m);
+			const __m128i magic = _mm_set1_epi64x(0x4330000000000000ll); // 2^52
+			const __m128d biased = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), magic));
+			e = double2Lanes(_mm_sub_pd(biased, _mm_set1_pd(4503599627370496.0 + 1023)));
+			const __m128i mantissa = _mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFll));
+			m = double2Lanes(_mm_castsi128_pd(_mm_or_si128(mantissa, _mm_set1_epi64x(0x3FF0000000000000ll))));
+		}
+#endif
+
+		//-----------------------------------------------------------------
+		// Natural logarithm of u in (0, 1]: log(m 2^e) = e log(2) + 2 atanh((m - 1) / (m + 1)),
+		// with m in [sqrt(1/2), sqrt(2)), where the atanh series converges to double precision in 11 terms.
+		template<class V>
+		V logUnit(V u)
+		{
+			V e, m;
+			splitExponent(u, e, m);
+			const auto high = greaterEqual(m, V(1.4142135623730951));
+			m = select(high, m * V(0.5), m);
+			e = select(high, e + V(1), e);
+			const V s = (m - V(1)) / (m + V(1));
+			const V z = s * s;
+			V p = V(1.0 / 21);
+			for(int k = 19; k >= 1; k -= 2)
+				p = p * z + V(1.0 / k);
+			return e * V(0.6931471805599453) + V(2) * s * p;
+		}
+
+		//-----------------------------------------------------------------
+		// sin(2 pi a) and cos(2 pi a) for a in [0, 1]: Taylor polynomials on the nearest quarter turn,
+		// within pi/4 of it, rotated by the quarter. Quarters come from compares, so no rounding mode is involved.
+		template<class V>
+		void sinCosTwoPi(V a, V& s, V& c)
+		{
+			const V one(1);
+			const V zero(0);
+			const V quarter = select(greaterEqual(a, V(0.125)), one, zero) + select(greaterEqual(a, V(0.375)), one, zero)
+				+ select(greaterEqual(a, V(0.625)), one, zero) + select(greaterEqual(a, V(0.875)), one, zero);
+			const V t = (a - quarter * V(0.25)) * V(Constants<double>::twoPi);
+			const V z = t * t;
+			// Up to t^15 and t^16, below double precision for |t| <= pi/4
+			V sp = V(-1.0 / 1307674368000);
+			V cp = V(1.0 / 20922789888000);
+			constexpr double SinCoefficients[] = { 1.0 / 6227020800, -1.0 / 39916800, 1.0 / 362880, -1.0 / 5040, 1.0 / 120, -1.0 / 6, 1 };
+			constexpr double CosCoefficients[] = { -1.0 / 87178291200, 1.0 / 479001600, -1.0 / 3628800, 1.0 / 40320, -1.0 / 720,
+				1.0 / 24, -0.5, 1 };
+			for(double k : SinCoefficients)
+				sp = sp * z + V(k);
+			for(double k : CosCoefficients)
+				cp = cp * z + V(k);
+			sp = sp * t;
+			// Quarter q turns (sin, cos) into (sin, cos), (cos, -sin), (-sin, -cos), (-cos, sin)
+			const auto swap = either(equal(quarter, one), equal(quarter, V(3)));
+			const auto negateSin = either(equal(quarter, V(2)), equal(quarter, V(3)));
+			const auto negateCos = either(equal(quarter, one), equal(quarter, V(2)));
+			const V sinRotated = select(swap, cp, sp);
+			const V cosRotated = select(swap, sp, cp);
+			s = select(negateSin, zero - sinRotated, sinRotated);
+			c = select(negateCos, zero - cosRotated, cosRotated);
+		}
+
+		//-----------------------------------------------------------------
+		// Three standard normal deviates from four uniforms in (0, 1]. The second pair only needs one of its two deviates.
+		template<class V>
+		void boxMuller3(V r1, V a1, V r2, V a2, V& gx, V& gy, V& gz)
+		{
+			V s1, c1, s2, c2;
+			sinCosTwoPi(a1, s1, c1);
+			sinCosTwoPi(a2, s2, c2);
+			const V r = squareRoot(V(-2) * logUnit(r1));
+			gx = r * c1;
+			gy = r * s1;
+			gz = squareRoot(V(-2) * logUnit(r2)) * c2;
+		}
+	}
+
+	//-----------------------------------------------------------------
+	// Counter-based random numbers. Every draw is a pure function of (seed, stream, id, counter), with no state
+	// carried between draws, so any subset of them can be generated in any order, on any thread, and still give
+	// the same values. Typical use keys id by an item (e.g. an atom) and counter by time step.
+	// Streams separate independent uses of the same seed.
+	class CounterRandom
+	{
+	public:
+		// Maximum number of ids per batch call. Keeps the working set in L1.
+		static constexpr int BlockSize = 256;
+
+		CounterRandom() = default;
+		CounterRandom(uint64_t seed, uint32_t stream = 0)
+			: m_key0(uint32_t(seed))
+			, m_key1(uint32_t(seed >> 32))
+			, m_stream(stream)
+		{}
+
+		// 128 random bits
+		std::array<uint32_t, 4> bits(uint32_t id, uint64_t counter) const
+		{
+			std::array<uint32_t, 4> c = { id, m_stream, uint32_t(counter), uint32_t(counter >> 32) };
+			philox4x32(c[0], c[1], c[2], c[3], m_key0, m_key1);
+			return c;
+		}
+
+		// Four uniforms in (0, 1], so they can go through a logarithm
+		template<class T>
+		std::array<T, 4> uniform4(uint32_t id, uint64_t counter) const
+		{
+			const auto b = bits(id, counter);
+			return { toUnit<T>(b[0]), toUnit<T>(b[1]), toUnit<T>(b[2]), toUnit<T>(b[3]) };
+		}
+
+		// Batch of four uniforms in (0, 1] for each of count ids, all at the same counter.
+		// Hashing runs in its own pass over the block, four ids at a time.
+		template<class T>
+		void uniforms(const int* ids, int count, uint64_t counter, T* u0, T* u1, T* u2, T* u3) const
+		{
+			assert(count <= BlockSize);
+			alignas(16) uint32_t c0[BlockSize];
+			alignas(16) uint32_t c1[BlockSize];
+			alignas(16) uint32_t c2[BlockSize];
+			alignas(16) uint32_t c3[BlockSize];
+			const uint32_t lo = uint32_t(counter);
+			const uint32_t hi = uint32_t(counter >> 32);
+			int i = 0;
+#ifdef MATH_RANDOM_SSE2
+			for(; i + 4 <= count; i += 4)
+			{
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + i));
+				__m128i b = _mm_set1_epi32(int(m_stream));
+				__m128i c = _mm_set1_epi32(int(lo));
+				__m128i d = _mm_set1_epi32(int(hi));
+				philox4x32(a, b, c, d, m_key0, m_key1);
+				_mm_store_si128(reinterpret_cast<__m128i*>(c0 + i), a);
+				_mm_store_si128(reinterpret_cast<__m128i*>(c1 + i), b);
+				_mm_store_si128(reinterpret_cast<__m128i*>(c2 + i), c);
+				_mm_store_si128(reinterpret_cast<__m128i*>(c3 + i), d);
+			}
+#endif
+			for(; i < count; ++i)
+			{
+				uint32_t a = uint32_t(ids[i]), b = m_stream, c = lo, d = hi;
+				philox4x32(a, b, c, d, m_key0, m_key1);
+				c0[i] = a;
+				c1[i] = b;
+				c2[i] = c;
+				c3[i] = d;
+			}
+			for(i = 0; i < count; ++i)
+			{
+				u0[i] = toUnit<T>(c0[i]);
+				u1[i] = toUnit<T>(c1[i]);
+				u2[i] = toUnit<T>(c2[i]);
+				u3[i] = toUnit<T>(c3[i]);
+			}
+		}
+
+		// Batch of three standard normal deviates for each of count ids, from Box-Muller on one uniform4.
+		// The transform runs on pairs of ids with SSE2, padding an odd count, so every deviate comes out of the same lanes.
+		template<class T>
+		void gaussians3(const int* ids, int count, uint64_t counter, T* gx, T* gy, T* gz) const
+		{
+			alignas(16) double r1[BlockSize];
+			alignas(16) double a1[BlockSize];
+			alignas(16) double r2[BlockSize];
+			alignas(16) double a2[BlockSize];
+			uniforms(ids, count, counter, r1, a1, r2, a2);
+#ifdef MATH_RANDOM_SSE2
+			if(count % 2)
+				r1[count] = a1[count] = r2[count] = a2[count] = 1;
+			using Lanes = detail::double2Lanes;
+			for(int i = 0; i < count; i += 2)
+			{
+				Lanes x, y, z;
+				detail::boxMuller3(Lanes(_mm_load_pd(r1 + i)), Lanes(_mm_load_pd(a1 + i)), Lanes(_mm_load_pd(r2 + i)),
+					Lanes(_mm_load_pd(a2 + i)), x, y, z);
+				_mm_store_pd(r1 + i, x.m);
+				_mm_store_pd(a1 + i, y.m);
+				_mm_store_pd(r2 + i, z.m);
+			}
+#else
+			for(int i = 0; i < count; ++i)
+				detail::boxMuller3(r1[i], a1[i], r2[i], a2[i], r1[i], a1[i], r2[i]);
+#endif
+			for(int i = 0; i < count; ++i)
+			{
+				gx[i] = T(r1[i]);
+				gy[i] = T(a1[i]);
+				gz[i] = T(r2[i]);
+			}
+		}
+
+	private:
+		// (x + 1) / 2^32. Floats round the top values to exactly 1, which is still in range.
+		template<class T>
+		static T toUnit(uint32_t x)
+		{
+			return T((double(x) + 1) * (1.0 / 4294967296.0));
+		}
+
+		uint32_t m_key0 = 0;
+		uint32_t m_key1 = 0;
+		uint32_t m_stream = 0;
+	};
+}
@@ -25,9 +25,12 @@
 
 #include <immintrin.h>
 #include <xmmintrin.h>
+#ifdef _MSC_VER
 #include <zmmintrin.h>
+#endif
 
 #include <array>
+#include <cstdint>
 #include "vector.h"
 
 namespace math
@@ -59,6 +62,28 @@ namespace math
 
 		explicit float4(__m128 x) : m(x) {}
 
+		// Lane traits, shared by all packed types so kernels can be written once for any width
+		using Scalar = float;
+		using Mask = float4; // All bits set in active lanes
+		static constexpr int Width = 4;
+
+		static float4 load(const float* p) {
+			return float4(_mm_loadu_ps(p));
+		}
+
+		static float4 gather(const float* base, const int* idx) {
+			return float4(_mm_set_ps(base[idx[3]], base[idx[2]], base[idx[1]], base[idx[0]]));
+		}
+
+		// Mask with the first n lanes active
+		static Mask firstLanes(int n) {
+			return float4(_mm_cmplt_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set_ps1(float(n))));
+		}
+
+		void store(float* p) const {
+			_mm_storeu_ps(p, m);
+		}
+
 		float4 operator+(const float4& b) const {
 			return float4(_mm_add_ps(m, b.m));
 		}
@@ -87,6 +112,26 @@ namespace math
 			return float4(_mm_cmpge_ps(m, b.m));
 		}
 
+		float4 operator<(const float4& b) const {
+			return float4(_mm_cmplt_ps(m, b.m));
+		}
+
+		float4 operator&(const float4& b) const {
+			return float4(_mm_and_ps(m, b.m));
+		}
+
+		// this*b + c;
+		float4 mul_add(const float4& b, const float4& c) const {
+			return float4(_mm_add_ps(_mm_mul_ps(m, b.m), c.m));
+		}
+
+		// Sum of all lanes
+		float hSum() const {
+			__m128 t = _mm_add_ps(m, _mm_movehl_ps(m, m));
+			t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+			return _mm_cvtss_f32(t);
+		}
+
 		bool any() const
 		{
 			return _mm_movemask_ps(m) != 0;
@@ -144,6 +189,23 @@ namespace math
 		return float4(_mm_max_ps(a.m,b.m));
 	}
 
+	inline auto sqrt(float4 a)
+	{
+		return float4(_mm_sqrt_ps(a.m));
+	}
+
+	// Round to the nearest integer, ties to even (SSE4.1)
+	inline auto nearbyint(float4 a)
+	{
+		return float4(_mm_round_ps(a.m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+
+	// a in active lanes of the mask, 0 elsewhere
+	inline auto select(float4 mask, float4 a)
+	{
+		return mask & a;
+	}
+
 	inline float float4::hMin() const
 	{
 		float4 v = min(*this, shuffle<2,3,0,1>());
@@ -204,15 +266,104 @@ namespace math
 		return VecSimd3f(_mm_max_ps(a.m,b.m));
 	}
 
+	//-----------------------------------------------------------------
+	// Explicitly SIMD set of 2 doubles (SSE2, rounding needs SSE4.1)
+	class double2
+	{
+	public:
+		using Scalar = double;
+		using Mask = double2;
+		static constexpr int Width = 2;
+
+		double2() = default;
+		explicit double2(double x) : m(_mm_set1_pd(x)) {}
+		explicit double2(__m128d x) : m(x) {}
+
+		static double2 load(const double* p) {
+			return double2(_mm_loadu_pd(p));
+		}
+
+		static double2 gather(const double* base, const int* idx) {
+			return double2(_mm_set_pd(base[idx[1]], base[idx[0]]));
+		}
+
+		static Mask firstLanes(int n) {
+			return double2(_mm_cmplt_pd(_mm_set_pd(1.0, 0.0), _mm_set1_pd(double(n))));
+		}
+
+		void store(double* p) const {
+			_mm_storeu_pd(p, m);
+		}
+
+		double2 operator+(const double2& b) const { return double2(_mm_add_pd(m, b.m)); }
+		double2 operator-(const double2& b) const { return double2(_mm_sub_pd(m, b.m)); }
+		double2 operator*(const double2& b) const { return double2(_mm_mul_pd(m, b.m)); }
+		double2 operator/(const double2& b) const { return double2(_mm_div_pd(m, b.m)); }
+		double2 operator<(const double2& b) const { return double2(_mm_cmplt_pd(m, b.m)); }
+		double2 operator&(const double2& b) const { return double2(_mm_and_pd(m, b.m)); }
+
+		// this*b + c;
+		double2 mul_add(const double2& b, const double2& c) const {
+			return double2(_mm_add_pd(_mm_mul_pd(m, b.m), c.m));
+		}
+
+		double hSum() const {
+			return _mm_cvtsd_f64(_mm_add_sd(m, _mm_unpackhi_pd(m, m)));
+		}
+
+		__m128d m;
+	};
+
+	inline auto sqrt(double2 a)
+	{
+		return double2(_mm_sqrt_pd(a.m));
+	}
+
+	inline auto nearbyint(double2 a)
+	{
+		return double2(_mm_round_pd(a.m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+
+	inline auto select(double2 mask, double2 a)
+	{
+		return mask & a;
+	}
+
+	inline auto min(double2 a, double2 b)
+	{
+		return double2(_mm_min_pd(a.m, b.m));
+	}
+
+	inline auto max(double2 a, double2 b)
+	{
+		return double2(_mm_max_pd(a.m, b.m));
+	}
+
+	// Conversions between the lanes of a float4 and two double2, low lanes first
+	inline auto narrow(const double2 (&d)[2])
+	{
+		return float4(_mm_movelh_ps(_mm_cvtpd_ps(d[0].m), _mm_cvtpd_ps(d[1].m)));
+	}
+
+	inline void widen(float4 f, double2 (&d)[2])
+	{
+		d[0] = double2(_mm_cvtps_pd(f.m));
+		d[1] = double2(_mm_cvtps_pd(_mm_movehl_ps(f.m, f.m)));
+	}
+
 	//-----------------------------------------------------------------
 	// A pack of 4 vec3 implemented using simd packed 4 floats
 	using Vec3f4 = Vector3<float4>; // simd4 vectors of 3 components
 
 	//-----------------------------------------------------------------
-	// Explicitly SIMD set of 8 Vec3fs
+	// Explicitly SIMD set of 8 Vec3fs (AVX2 + FMA)
 	class float8
 	{
 	public:
+		using Scalar = float;
+		using Mask = float8;
+		static constexpr int Width = 8;
+
 		float8() = default;
 		explicit float8(const float* p) {
 			m = _mm256_load_ps(p);
@@ -228,6 +379,24 @@ namespace math
 
 		explicit float8(__m256 x) : m(x) {}
 
+		static float8 load(const float* p) {
+			return float8(_mm256_loadu_ps(p));
+		}
+
+		// Built from scalar loads: hardware gathers are microcoded and slower than this on most current cores
+		static float8 gather(const float* base, const int* idx) {
+			return float8(_mm256_set_ps(base[idx[7]], base[idx[6]], base[idx[5]], base[idx[4]], base[idx[3]], base[idx[2]], base[idx[1]], base[idx[0]]));
+		}
+
+		static Mask firstLanes(int n) {
+			const __m256 lane = _mm256_set_ps(7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+			return float8(_mm256_cmp_ps(lane, _mm256_set1_ps(float(n)), _CMP_LT_OQ));
+		}
+
+		void store(float* p) const {
+			_mm256_storeu_ps(p, m);
+		}
+
 		float8 operator+(const float8& b) const
 		{
 			return float8(_mm256_add_ps(m, b.m));
@@ -248,13 +417,314 @@ namespace math
 			return float8(_mm256_div_ps(m, b.m));
 		}
 
+		float8 operator<(const float8& b) const
+		{
+			return float8(_mm256_cmp_ps(m, b.m, _CMP_LT_OQ));
+		}
+
+		float8 operator&(const float8& b) const
+		{
+			return float8(_mm256_and_ps(m, b.m));
+		}
+
 		// this*b + c;
-		float8 mul_add(const float8& b, const float8& c)
+		float8 mul_add(const float8& b, const float8& c) const
 		{
 			return float8(_mm256_fmadd_ps(m,b.m,c.m));
 		}
 
-	private:
+		float hSum() const
+		{
+			__m128 t = _mm_add_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+			t = _mm_add_ps(t, _mm_movehl_ps(t, t));
+			t = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+			return _mm_cvtss_f32(t);
+		}
+
 		__m256 m;
 	};
+
+	inline auto sqrt(float8 a)
+	{
+		return float8(_mm256_sqrt_ps(a.m));
+	}
+
+	inline auto nearbyint(float8 a)
+	{
+		return float8(_mm256_round_ps(a.m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+
+	inline auto select(float8 mask, float8 a)
+	{
+		return mask & a;
+	}
+
+	inline auto min(float8 a, float8 b)
+	{
+		return float8(_mm256_min_ps(a.m, b.m));
+	}
+
+	inline auto max(float8 a, float8 b)
+	{
+		return float8(_mm256_max_ps(a.m, b.m));
+	}
+
+	//-----------------------------------------------------------------
+	// Explicitly SIMD set of 4 doubles (AVX2 + FMA)
+	class double4
+	{
+	public:
+		using Scalar = double;
+		using Mask = double4;
+		static constexpr int Width = 4;
+
+		double4() = default;
+		explicit double4(double x) : m(_mm256_set1_pd(x)) {}
+		explicit double4(__m256d x) : m(x) {}
+
+		static double4 load(const double* p) {
+			return double4(_mm256_loadu_pd(p));
+		}
+
+		static double4 gather(const double* base, const int* idx) {
+			return double4(_mm256_set_pd(base[idx[3]], base[idx[2]], base[idx[1]], base[idx[0]]));
+		}
+
+		static Mask firstLanes(int n) {
+			return double4(_mm256_cmp_pd(_mm256_set_pd(3.0, 2.0, 1.0, 0.0), _mm256_set1_pd(double(n)), _CMP_LT_OQ));
+		}
+
+		void store(double* p) const {
+			_mm256_storeu_pd(p, m);
+		}
+
+		double4 operator+(const double4& b) const { return double4(_mm256_add_pd(m, b.m)); }
+		double4 operator-(const double4& b) const { return double4(_mm256_sub_pd(m, b.m)); }
+		double4 operator*(const double4& b) const { return double4(_mm256_mul_pd(m, b.m)); }
+		double4 operator/(const double4& b) const { return double4(_mm256_div_pd(m, b.m)); }
+		double4 operator<(const double4& b) const { return double4(_mm256_cmp_pd(m, b.m, _CMP_LT_OQ)); }
+		double4 operator&(const double4& b) const { return double4(_mm256_and_pd(m, b.m)); }
+
+		// this*b + c;
+		double4 mul_add(const double4& b, const double4& c) const {
+			return double4(_mm256_fmadd_pd(m, b.m, c.m));
+		}
+
+		double hSum() const {
+			__m128d t = _mm_add_pd(_mm256_castpd256_pd128(m), _mm256_extractf128_pd(m, 1));
+			return _mm_cvtsd_f64(_mm_add_sd(t, _mm_unpackhi_pd(t, t)));
+		}
+
+		__m256d m;
+	};
+
+	inline auto sqrt(double4 a)
+	{
+		return double4(_mm256_sqrt_pd(a.m));
+	}
+
+	inline auto nearbyint(double4 a)
+	{
+		return double4(_mm256_round_pd(a.m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+
+	inline auto select(double4 mask, double4 a)
+	{
+		return mask & a;
+	}
+
+	inline auto min(double4 a, double4 b)
+	{
+		return double4(_mm256_min_pd(a.m, b.m));
+	}
+
+	inline auto max(double4 a, double4 b)
+	{
+		return double4(_mm256_max_pd(a.m, b.m));
+	}
+
+	// Conversions between the lanes of a float8 and two double4, low lanes first
+	inline auto narrow(const double4 (&d)[2])
+	{
+		return float8(_mm256_set_m128(_mm256_cvtpd_ps(d[1].m), _mm256_cvtpd_ps(d[0].m)));
+	}
+
+	inline void widen(float8 f, double4 (&d)[2])
+	{
+		d[0] = double4(_mm256_cvtps_pd(_mm256_castps256_ps128(f.m)));
+		d[1] = double4(_mm256_cvtps_pd(_mm256_extractf128_ps(f.m, 1)));
+	}
+
+	//-----------------------------------------------------------------
+	// AVX-512 packs. Comparisons produce bit masks instead of full width lane masks.
+	struct mask16
+	{
+		mask16 operator&(mask16 b) const { return { __mmask16(k & b.k) }; }
+		__mmask16 k;
+	};
+
+	struct mask8
+	{
+		mask8 operator&(mask8 b) const { return { __mmask8(k & b.k) }; }
+		__mmask8 k;
+	};
+
+	//-----------------------------------------------------------------
+	// Explicitly SIMD set of 16 floats (AVX-512F)
+	class float16
+	{
+	public:
+		using Scalar = float;
+		using Mask = mask16;
+		static constexpr int Width = 16;
+
+		float16() = default;
+		explicit float16(float x) : m(_mm512_set1_ps(x)) {}
+		explicit float16(__m512 x) : m(x) {}
+
+		static float16 load(const float* p) {
+			return float16(_mm512_loadu_ps(p));
+		}
+
+		static float16 gather(const float* base, const int* idx) {
+			return float16(_mm512_set_ps(base[idx[15]], base[idx[14]], base[idx[13]], base[idx[12]], base[idx[11]], base[idx[10]], base[idx[9]], base[idx[8]],
+				base[idx[7]], base[idx[6]], base[idx[5]], base[idx[4]], base[idx[3]], base[idx[2]], base[idx[1]], base[idx[0]]));
+		}
+
+		static Mask firstLanes(int n) {
+			return { __mmask16(n >= Width ? 0xffff : (1u << n) - 1) };
+		}
+
+		void store(float* p) const {
+			_mm512_storeu_ps(p, m);
+		}
+
+		float16 operator+(const float16& b) const { return float16(_mm512_add_ps(m, b.m)); }
+		float16 operator-(const float16& b) const { return float16(_mm512_sub_ps(m, b.m)); }
+		float16 operator*(const float16& b) const { return float16(_mm512_mul_ps(m, b.m)); }
+		float16 operator/(const float16& b) const { return float16(_mm512_div_ps(m, b.m)); }
+		Mask operator<(const float16& b) const { return { _mm512_cmp_ps_mask(m, b.m, _CMP_LT_OQ) }; }
+
+		// this*b + c;
+		float16 mul_add(const float16& b, const float16& c) const {
+			return float16(_mm512_fmadd_ps(m, b.m, c.m));
+		}
+
+		float hSum() const {
+			return _mm512_reduce_add_ps(m);
+		}
+
+		__m512 m;
+	};
+
+	inline auto sqrt(float16 a)
+	{
+		return float16(_mm512_sqrt_ps(a.m));
+	}
+
+	inline auto nearbyint(float16 a)
+	{
+		return float16(_mm512_roundscale_ps(a.m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+
+	inline auto select(mask16 mask, float16 a)
+	{
+		return float16(_mm512_maskz_mov_ps(mask.k, a.m));
+	}
+
+	inline auto min(float16 a, float16 b)
+	{
+		return float16(_mm512_min_ps(a.m, b.m));
+	}
+
+	inline auto max(float16 a, float16 b)
+	{
+		return float16(_mm512_max_ps(a.m, b.m));
+	}
+
+	//-----------------------------------------------------------------
+	// Explicitly SIMD set of 8 doubles (AVX-512F)
+	class double8
+	{
+	public:
+		using Scalar = double;
+		using Mask = mask8;
+		static constexpr int Width = 8;
+
+		double8() = default;
+		explicit double8(double x) : m(_mm512_set1_pd(x)) {}
+		explicit double8(__m512d x) : m(x) {}
+
+		static double8 load(const double* p) {
+			return double8(_mm512_loadu_pd(p));
+		}
+
+		static double8 gather(const double* base, const int* idx) {
+			return double8(_mm512_set_pd(base[idx[7]], base[idx[6]], base[idx[5]], base[idx[4]], base[idx[3]], base[idx[2]], base[idx[1]], base[idx[0]]));
+		}
+
+		static Mask firstLanes(int n) {
+			return { __mmask8(n >= Width ? 0xff : (1u << n) - 1) };
+		}
+
+		void store(double* p) const {
+			_mm512_storeu_pd(p, m);
+		}
+
+		double8 operator+(const double8& b) const { return double8(_mm512_add_pd(m, b.m)); }
+		double8 operator-(const double8& b) const { return double8(_mm512_sub_pd(m, b.m)); }
+		double8 operator*(const double8& b) const { return double8(_mm512_mul_pd(m, b.m)); }
+		double8 operator/(const double8& b) const { return double8(_mm512_div_pd(m, b.m)); }
+		Mask operator<(const double8& b) const { return { _mm512_cmp_pd_mask(m, b.m, _CMP_LT_OQ) }; }
+
+		// this*b + c;
+		double8 mul_add(const double8& b, const double8& c) const {
+			return double8(_mm512_fmadd_pd(m, b.m, c.m));
+		}
+
+		double hSum() const {
+			return _mm512_reduce_add_pd(m);
+		}
+
+		__m512d m;
+	};
+
+	inline auto sqrt(double8 a)
+	{
+		return double8(_mm512_sqrt_pd(a.m));
+	}
+
+	inline auto nearbyint(double8 a)
+	{
+		return double8(_mm512_roundscale_pd(a.m, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+
+	inline auto select(mask8 mask, double8 a)
+	{
+		return double8(_mm512_maskz_mov_pd(mask.k, a.m));
+	}
+
+	inline auto min(double8 a, double8 b)
+	{
+		return double8(_mm512_min_pd(a.m, b.m));
+	}
+
+	inline auto max(double8 a, double8 b)
+	{
+		return double8(_mm512_max_pd(a.m, b.m));
+	}
+
+	// Conversions between the lanes of a float16 and two double8, low lanes first
+	inline auto narrow(const double8 (&d)[2])
+	{
+		const __m256d lo = _mm256_castps_pd(_mm512_cvtpd_ps(d[0].m));
+		const __m256d hi = _mm256_castps_pd(_mm512_cvtpd_ps(d[1].m));
+		return float16(_mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(lo), hi, 1)));
+	}
+
+	inline void widen(float16 f, double8 (&d)[2])
+	{
+		d[0] = double8(_mm512_cvtps_pd(_mm512_castps512_ps256(f.m)));
+		d[1] = double8(_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(f.m), 1))));
+	}
 }
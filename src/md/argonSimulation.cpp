@@ -0,0 +1,997 @@
+// Molecular dynamics playground
+#include "argonSimulation.h"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <math/random.h>
+
+using namespace math;
+
+namespace md
+{
+    namespace
+    {
+        // Independent counter-based random streams of the same seed. Draws are keyed by atom id,
+        // so they don't depend on the order of atoms in memory, or on how they are split across threads.
+        enum RandomStream : uint32_t
+        {
+            ScatterStream,
+            VelocityStream, // Maxwell-Boltzmann initial velocities
+            LangevinStream, // Random kicks, keyed by step
+            SpeciesStream
+        };
+
+        // Pair list kernels of positions T and coefficients C
+        template<class T, class C>
+        PairListKernelSet<T, C> kernelsFor(SimdLevel level)
+        {
+            if constexpr(std::is_same_v<T, C>)
+                return pairListKernels(level, T());
+            else
+                return pairListKernels(level, T(), C());
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    ArgonSimulation::ArgonSimulation(const Config& _config)
+        : config(_config)
+        , m_boxSize(_config.density > 0 ? std::cbrt(_config.numAtoms / _config.density) : _config.boxSize)
+        , m_particles(_config.numAtoms)
+        , m_msd(MultiTauCorrelator::Kind::SquaredDisplacement)
+        , m_vacf(MultiTauCorrelator::Kind::Product)
+    {
+        // Init the simulation pool
+        updateSpecies();
+        assignSpecies();
+        if(config.initialPositions == InitialPositions::FCC)
+            placeOnLattice();
+        else
+            scatterParticles();
+        if(config.initialTemperature > 0)
+            seedVelocities(config.initialTemperature);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::scatterParticles()
+    {
+        for(int i = 0; i < numAtoms(); ++i)
+        {
+            const Vec3d p = scatterPosition(m_particles.id[i]);
+            m_particles.pos.set(i, p);
+            m_particles.unwrapped.set(i, p);
+        }
+        // Force a neighbor list rebuild
+        m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        m_forcesCurrent = false;
+        resetCorrelators();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::placeOnLattice()
+    {
+        // Unit cell basis, offset by a quarter cell so no site sits on the box boundary
+        constexpr double Basis[4][3] = { { 0.25, 0.25, 0.25 }, { 0.75, 0.75, 0.25 }, { 0.75, 0.25, 0.75 }, { 0.25, 0.75, 0.75 } };
+        const int n = numAtoms();
+        int cellsPerDim = 1;
+        while(4 * cellsPerDim * cellsPerDim * cellsPerDim < n)
+            ++cellsPerDim;
+        const double a = m_boxSize / cellsPerDim;
+        const double origin = -m_boxSize / 2;
+        int i = 0;
+        for(int cz = 0; cz < cellsPerDim && i < n; ++cz)
+        {
+            for(int cy = 0; cy < cellsPerDim && i < n; ++cy)
+            {
+                for(int cx = 0; cx < cellsPerDim && i < n; ++cx)
+                {
+                    for(int b = 0; b < 4 && i < n; ++b, ++i)
+                    {
+                        const Vec3d p = { origin + a * (cx + Basis[b][0]), origin + a * (cy + Basis[b][1]), origin + a * (cz + Basis[b][2]) };
+                        m_particles.pos.set(i, p);
+                        m_particles.unwrapped.set(i, p);
+                    }
+                }
+            }
+        }
+        // Force a neighbor list rebuild
+        m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        m_forcesCurrent = false;
+        resetCorrelators();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::seedVelocities(double temperature)
+    {
+        const int n = numAtoms();
+        auto& vel = m_particles.vel;
+        const int* type = m_particles.type;
+        const CounterRandom rng(uint32_t(config.seed), VelocityStream);
+        for(int begin = 0; begin < n; begin += CounterRandom::BlockSize)
+        {
+            const int count = std::min(CounterRandom::BlockSize, n - begin);
+            rng.gaussians3(m_particles.id + begin, count, 0, vel.x + begin, vel.y + begin, vel.z + begin);
+        }
+
+        // Each component has variance T / m. Zero the total momentum, then scale to the exact kinetic energy
+        // of the target temperature.
+        updateSpecies();
+        double totalMass = 0;
+        for(int i = 0; i < n; ++i)
+            totalMass += m_mass[type[i]];
+        double sumMV2 = 0;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            double* v = vel.component(axis);
+            double momentum = 0;
+            for(int i = 0; i < n; ++i)
+            {
+                v[i] *= m_invSqrtMass[type[i]];
+                momentum += m_mass[type[i]] * v[i];
+            }
+            const double mean = n > 0 ? momentum / totalMass : 0;
+            for(int i = 0; i < n; ++i)
+            {
+                v[i] -= mean;
+                sumMV2 += m_mass[type[i]] * v[i] * v[i];
+            }
+        }
+        const double scale = sumMV2 > 0 ? std::sqrt(temperature * degreesOfFreedom() / sumMV2) : 0;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            double* v = vel.component(axis);
+            for(int i = 0; i < n; ++i)
+                v[i] *= scale;
+        }
+        m_kineticEnergy = computeKineticEnergy();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::assignSpecies()
+    {
+        updateSpecies();
+        for(int i = 0; i < numAtoms(); ++i)
+            m_particles.type[i] = drawSpecies(m_particles.id[i]);
+        m_forcesCurrent = false;
+        m_kineticEnergy = computeKineticEnergy();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    int ArgonSimulation::drawSpecies(int id) const
+    {
+        const auto& species = config.species;
+        if(species.size() < 2)
+            return 0;
+        double total = 0;
+        for(const Species& s : species)
+            total += std::max(s.fraction, 0.0);
+        double u = CounterRandom(uint32_t(config.seed), SpeciesStream).uniform4<double>(uint32_t(id), 0)[0] * total;
+        for(int t = 0; t < int(species.size()) - 1; ++t)
+        {
+            u -= std::max(species[t].fraction, 0.0);
+            if(u < 0)
+                return t;
+        }
+        return int(species.size()) - 1;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::updateSpecies()
+    {
+        const PairTable* table = config.pairTable.get();
+        m_pairCoefficients.build(config.species, config.pairOverrides, config.cutoff, config.shiftedForce, table ? table->cutoff() : 0);
+        const int numTypes = m_pairCoefficients.numTypes();
+        m_mass.resize(numTypes);
+        m_invMass.resize(numTypes);
+        m_invSqrtMass.resize(numTypes);
+        m_unitMass = true;
+        for(int t = 0; t < numTypes; ++t)
+        {
+            m_mass[t] = config.species.empty() ? 1 : config.species[t].mass;
+            m_invMass[t] = 1 / m_mass[t];
+            m_invSqrtMass[t] = std::sqrt(m_invMass[t]);
+            m_unitMass &= m_mass[t] == 1;
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::resize(int numAtoms)
+    {
+        const int oldSize = m_particles.size();
+        m_particles.resize(numAtoms);
+        for(int i = oldSize; i < numAtoms; ++i)
+        {
+            const Vec3d p = scatterPosition(m_particles.id[i]);
+            m_particles.pos.set(i, p);
+            m_particles.unwrapped.set(i, p);
+            m_particles.type[i] = drawSpecies(m_particles.id[i]);
+        }
+        // Lists refer to the old atom count
+        m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        m_forcesCurrent = false;
+        resetCorrelators();
+        m_kineticEnergy = computeKineticEnergy();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Velocity Verlet: half kick, drift, new forces, half kick.
+    // With r-RESPA, half kicks of the outer forces over the whole step wrap respaSteps velocity Verlet sub-steps
+    // of the inner forces. The closing and opening half kicks of consecutive sub-steps are merged into one.
+    void ArgonSimulation::step()
+    {
+        updateSpecies();
+        if(!m_forcesCurrent || !(forceBands() == m_forceBands))
+            computeInitialForces();
+
+        const double h = config.timeStep;
+        const bool multipleTimeStep = usesMultipleTimeStep();
+        const int numInner = multipleTimeStep ? config.respaSteps : 1;
+        const double dt = h / numInner;
+        auto& acc = m_particles.acc;
+        if(multipleTimeStep)
+            kick(m_particles.accOuter, h / 2);
+        PairListSums sums;
+        for(int k = 0; k < numInner; ++k)
+        {
+            const double kickStep = k == 0 ? dt / 2 : dt;
+            if(config.freeze)
+                kick(acc, kickStep);
+            else
+                updatePositions(dt, kickStep);
+            // Reorder when the lists have to be rebuilt anyway
+            if(k == 0 && config.reorderInterval > 0 && ++m_stepsSinceReorder >= config.reorderInterval && neighborListRebuildDue())
+                reorderAtoms();
+            sums = computeAccelerations(multipleTimeStep ? PairBand::Inner : PairBand::All);
+        }
+        if(multipleTimeStep)
+        {
+            kick(acc, dt / 2);
+            const PairListSums outer = computeAccelerations(PairBand::Outer);
+            sums.energy += outer.energy;
+            sums.virial += outer.virial;
+        }
+        m_potentialEnergy = sums.energy;
+        m_virial = sums.virial;
+        if(config.rdfInterval > 0 && m_stepCount % uint64_t(config.rdfInterval) == 0)
+            sampleRadialDistribution();
+        // Closing half kick, with the thermostat and barostat
+        updateSpeeds(h, multipleTimeStep ? m_particles.accOuter : acc);
+        ++m_stepCount;
+        m_time += h;
+        if(config.observableInterval > 0 && m_stepCount % uint64_t(config.observableInterval) == 0)
+            m_observables.push(sampleObservables());
+        if(config.correlatorInterval > 0 && m_stepCount % uint64_t(config.correlatorInterval) == 0)
+            sampleCorrelators();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::resetCorrelators()
+    {
+        m_msd.reset(m_particles.idBound(), config.correlatorLevels);
+        m_vacf.reset(m_particles.idBound(), config.correlatorLevels);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::sampleCorrelators()
+    {
+        if(m_msd.numIds() != m_particles.idBound() || m_msd.numLevels() != std::max(1, config.correlatorLevels))
+            resetCorrelators();
+        m_msd.add(m_particles.unwrapped, m_particles.id, numAtoms());
+        m_vacf.add(m_particles.vel, m_particles.id, numAtoms());
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::reorderAtoms()
+    {
+        // Cells of the neighbor list size, capped so keys use at most 30 bits
+        constexpr int MaxCellsPerDim = 1 << 10;
+        const int n = numAtoms();
+        const double cellSize = double(config.cutoff) + config.skin;
+        const int cellsPerDim = std::clamp(int(m_boxSize / cellSize), 1, MaxCellsPerDim);
+        int bits = 1;
+        while((1 << bits) < cellsPerDim)
+            ++bits;
+        const double invCellSize = cellsPerDim / m_boxSize;
+        const double halfBoxSize = m_boxSize / 2;
+        auto cellCoord = [&](double x) {
+            return uint32_t(std::clamp(int((x + halfBoxSize) * invCellSize), 0, cellsPerDim - 1));
+        };
+
+        // Curve key in the high bits, current slot in the low bits, so atoms within a cell keep their relative order
+        auto& pos = m_particles.pos;
+        m_sortKeys.resize(n);
+        for(int i = 0; i < n; ++i)
+        {
+            const uint32_t cx = cellCoord(pos.x[i]);
+            const uint32_t cy = cellCoord(pos.y[i]);
+            const uint32_t cz = cellCoord(pos.z[i]);
+            const uint64_t key = config.reorderCurve == SpaceFillingCurve::Hilbert ? hilbertKey(cx, cy, cz, bits) : mortonKey(cx, cy, cz);
+            m_sortKeys[i] = (key << 32) | uint32_t(i);
+        }
+        std::sort(m_sortKeys.begin(), m_sortKeys.end());
+
+        m_order.resize(n);
+        for(int i = 0; i < n; ++i)
+            m_order[i] = int(m_sortKeys[i] & 0xffffffff);
+        m_particles.permute(m_order.data());
+
+        // Lists refer to atoms by slot
+        m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        m_stepsSinceReorder = 0;
+        ++m_numReorders;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool ArgonSimulation::saveCheckpoint(CheckpointWriter& writer, const std::string& path)
+    {
+        const std::vector<double> thermostatState = m_thermostat ? m_thermostat->state() : std::vector<double>();
+        const std::vector<double> barostatState = m_barostat ? m_barostat->state() : std::vector<double>();
+        if(thermostatState.size() > size_t(MaxExtendedState) || barostatState.size() > size_t(MaxExtendedState))
+            return false;
+
+        CheckpointHeader header;
+        header.numAtoms = numAtoms();
+        header.nextId = m_particles.idBound();
+        header.stepCount = m_stepCount;
+        header.time = m_time;
+        header.boxSize = m_boxSize;
+        header.boxScale = m_boxScale;
+        header.kineticEnergy = m_kineticEnergy;
+        header.potentialEnergy = m_potentialEnergy;
+        header.virial = m_virial;
+        header.cutoff = config.cutoff;
+        header.seed = config.seed;
+        header.numTypes = numSpecies();
+        header.thermostat = int32_t(m_thermostatKind);
+        header.barostat = int32_t(m_barostatKind);
+        header.thermostatStateSize = int32_t(thermostatState.size());
+        std::copy(thermostatState.begin(), thermostatState.end(), header.thermostatState);
+        header.barostatStateSize = int32_t(barostatState.size());
+        std::copy(barostatState.begin(), barostatState.end(), header.barostatState);
+        header.stepsSinceReorder = m_stepsSinceReorder;
+        writer.write(path, header, m_particles);
+        m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool ArgonSimulation::loadCheckpoint(const std::string& path)
+    {
+        // The saved types index the species tables, and the saved accelerations come from the saved cutoff
+        updateSpecies();
+        auto compatible = [this](const CheckpointHeader& header) {
+            return header.numTypes == numSpecies() && header.cutoff == double(config.cutoff);
+        };
+        CheckpointHeader header;
+        if(!readCheckpoint(path, header, m_particles, compatible))
+            return false;
+
+        m_stepCount = header.stepCount;
+        m_time = header.time;
+        m_boxSize = header.boxSize;
+        m_boxScale = header.boxScale;
+        m_kineticEnergy = header.kineticEnergy;
+        m_potentialEnergy = header.potentialEnergy;
+        m_virial = header.virial;
+        config.seed = header.seed;
+
+        // The extended system variables belong to the integrator stages that were running
+        config.thermostat = ThermostatKind(header.thermostat);
+        m_thermostatKind = config.thermostat;
+        m_thermostat = makeThermostat(config.thermostat);
+        if(m_thermostat)
+            m_thermostat->setState({ header.thermostatState, header.thermostatState + header.thermostatStateSize });
+        config.barostat = BarostatKind(header.barostat);
+        m_barostatKind = config.barostat;
+        m_barostat = makeBarostat(config.barostat);
+        if(m_barostat)
+            m_barostat->setState({ header.barostatState, header.barostatState + header.barostatStateSize });
+
+        // Derived structures are rebuilt from the restored atoms. The saved accelerations are current,
+        // assuming the same force split as the saved run.
+        m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        m_forcesCurrent = true;
+        m_forceBands = forceBands();
+        m_stepsSinceReorder = header.stepsSinceReorder;
+        m_rdf.clear();
+        resetCorrelators();
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Forces of the current positions, for the opening half kick of the first step.
+    // Also needed whenever the force split changes.
+    void ArgonSimulation::computeInitialForces()
+    {
+        PairListSums sums = computeAccelerations(usesMultipleTimeStep() ? PairBand::Inner : PairBand::All);
+        if(usesMultipleTimeStep())
+        {
+            const PairListSums outer = computeAccelerations(PairBand::Outer);
+            sums.energy += outer.energy;
+            sums.virial += outer.virial;
+        }
+        m_potentialEnergy = sums.energy;
+        m_virial = sums.virial;
+        m_forcesCurrent = true;
+        m_forceBands = forceBands();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    ListBands ArgonSimulation::forceBands() const
+    {
+        ListBands bands;
+        if(usesMultipleTimeStep())
+        {
+            bands.switchStart = std::max(0.0f, config.respaCutoff - config.respaSwitch);
+            bands.switchEnd = config.respaCutoff;
+        }
+        return bands;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool ArgonSimulation::neighborListRebuildDue() const
+    {
+        if(!usesNeighborList())
+            return true; // Other backends rebuild their structures every step
+        const bool halfList = config.forceBackend != ForceBackend::Threaded;
+        return m_neighbors.isStale(box(), config.cutoff, config.skin, halfList, forceBands())
+            || m_neighbors.needsRebuild(m_maxDisplacement2, m_boxSize);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void ArgonSimulation::kick(const Vec3Stream& acc, double h)
+    {
+        auto& vel = m_particles.vel;
+        for(int i = 0; i < numAtoms(); ++i)
+        {
+            vel.x[i] += h * acc.x[i];
+            vel.y[i] += h * acc.y[i];
+            vel.z[i] += h * acc.z[i];
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Kick the velocities by kickStep with the (inner) accelerations, then drift the positions over h
+    void ArgonSimulation::updatePositions(double h, double kickStep)
+    {
+        // Rescale the box and coordinates for the barostat in the same pass as the drift
+        const double scale = m_boxScale;
+        m_boxScale = 1;
+        m_boxSize *= scale;
+
+        const bool halfList = config.forceBackend != ForceBackend::Threaded;
+        // No need to track once a rebuild is due
+        const bool trackDisplacement = usesNeighborList() && !m_neighbors.needsRebuild(m_maxDisplacement2, m_boxSize)
+            && !m_neighbors.isStale(box(), config.cutoff, config.skin, halfList, forceBands());
+        const double referenceScale = m_neighbors.referenceScale(m_boxSize);
+        auto& pos = m_particles.pos;
+        auto& vel = m_particles.vel;
+        auto& acc = m_particles.acc;
+        auto& unwrapped = m_particles.unwrapped;
+        const double boxSize = m_boxSize;
+        const double halfBoxSize = boxSize / 2;
+        const double invBoxSize = 1 / boxSize;
+        const bool periodic = config.periodic;
+        // Closed boxes have reflecting walls: an atom past a face is mirrored back in and its velocity reversed.
+        // The unwrapped position follows the actual path.
+        auto reflect = [&](double& x, double& v, double& u) {
+            if(std::abs(x) <= halfBoxSize)
+                return;
+            const double reflected = std::clamp(std::copysign(boxSize, x) - x, -halfBoxSize, halfBoxSize);
+            u += reflected - x;
+            x = reflected;
+            v = -v;
+        };
+        for(int i = 0; i < numAtoms(); ++i)
+        {
+            vel.x[i] += kickStep * acc.x[i];
+            vel.y[i] += kickStep * acc.y[i];
+            vel.z[i] += kickStep * acc.z[i];
+            const double dx = vel.x[i] * h;
+            const double dy = vel.y[i] * h;
+            const double dz = vel.z[i] * h;
+            double x = scale * pos.x[i] + dx;
+            double y = scale * pos.y[i] + dy;
+            double z = scale * pos.z[i] + dz;
+            unwrapped.x[i] = scale * unwrapped.x[i] + dx;
+            unwrapped.y[i] = scale * unwrapped.y[i] + dy;
+            unwrapped.z[i] = scale * unwrapped.z[i] + dz;
+            // Keep it in the box
+            if(periodic)
+            {
+                x -= boxSize * std::floor((x + halfBoxSize) * invBoxSize);
+                y -= boxSize * std::floor((y + halfBoxSize) * invBoxSize);
+                z -= boxSize * std::floor((z + halfBoxSize) * invBoxSize);
+            }
+            else
+            {
+                reflect(x, vel.x[i], unwrapped.x[i]);
+                reflect(y, vel.y[i], unwrapped.y[i]);
+                reflect(z, vel.z[i], unwrapped.z[i]);
+            }
+            pos.x[i] = x;
+            pos.y[i] = y;
+            pos.z[i] = z;
+            // Track displacement for neighbor list invalidation
+            if(trackDisplacement)
+                m_maxDisplacement2 = std::max(m_maxDisplacement2, m_neighbors.displacement2(i, x, y, z, referenceScale));
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Pair accelerations of the given band, into accOuter for the outer band and into acc otherwise.
+    // Only Verlet list backends split the forces. Returns the potential energy and virial of the band.
+    PairListSums ArgonSimulation::computeAccelerations(PairBand band)
+    {
+        const int n = numAtoms();
+        // Clear previous accelerations
+        auto& acc = band == PairBand::Outer ? m_particles.accOuter : m_particles.acc;
+        std::fill_n(acc.x, n, 0.0);
+        std::fill_n(acc.y, n, 0.0);
+        std::fill_n(acc.z, n, 0.0);
+
+        // Iterate over every particle pair within the cutoff radius
+        const double cutoff = config.cutoff;
+        const double skin = config.skin;
+        PairParams params;
+        params.box = box();
+        params.coefficients = &m_pairCoefficients;
+        params.table = config.pairTable.get();
+        assert(!params.table || params.table->numTypes() == numSpecies());
+        const int* types = pairTypes();
+        PairListSums sums;
+        if(config.forceBackend != ForceBackend::Domains && m_domains)
+        {
+            // Release the domain threads. Atoms moved untracked since the Verlet list was built.
+            m_domains.reset();
+            m_maxDisplacement2 = std::numeric_limits<double>::infinity();
+        }
+        switch(config.forceBackend)
+        {
+            case ForceBackend::BruteForce:
+            {
+                for(int i = 0; i < n; ++i)
+                {
+                    for(int j = 0; j < i; ++j)
+                    {
+                        addPairForce(params, i, j, sums);
+                    }
+                }
+                break;
+            }
+            case ForceBackend::CellList:
+            {
+                m_cells.build(m_particles.pos, n, params.box, cutoff, types, numSpecies());
+                m_cells.forEachPair([&](int i, int j) { addPairForce(params, i, j, sums); });
+                break;
+            }
+            case ForceBackend::VerletList:
+            case ForceBackend::Threaded:
+            {
+                // Threads evaluate disjoint ranges of atoms i over full lists, so no atom is written by two threads
+                const bool threaded = config.forceBackend == ForceBackend::Threaded;
+                const int numThreads = std::max(1, config.numThreads);
+                if(threaded && (!m_pool || m_pool->size() != numThreads))
+                    m_pool = std::make_unique<ThreadPool>(numThreads);
+                ThreadPool* pool = threaded ? m_pool.get() : nullptr;
+
+                if(neighborListRebuildDue())
+                {
+                    m_cells.build(m_particles.pos, n, params.box, cutoff + skin, types, numSpecies());
+                    m_neighbors.build(m_cells, m_particles.pos, n, params.box, cutoff, skin, !threaded, pool, forceBands());
+                    m_maxDisplacement2 = 0;
+                }
+                switch(config.precision)
+                {
+                    case PairPrecision::Double:
+                        sums = computePairListForces<double>(params, band, m_particles.pos, acc, acc, pool);
+                        break;
+                    case PairPrecision::Single:
+                        sums = computePairListForces<float>(params, band, m_particles.posf, m_particles.accf, acc, pool);
+                        break;
+                    case PairPrecision::Mixed:
+                        sums = computePairListForces<double, float>(params, band, m_particles.pos, acc, acc, pool);
+                        break;
+                }
+                break;
+            }
+            case ForceBackend::Domains:
+            {
+                // Any invalidation since the last call redistributes the atoms. Domains track their own displacements.
+                const bool moved = m_maxDisplacement2 > 0;
+                m_maxDisplacement2 = 0;
+                // Domains keep no float copies of the positions: single precision evaluates as mixed
+                if(config.precision == PairPrecision::Double)
+                    sums = computeDomainForces<double>(params, acc, moved);
+                else
+                    sums = computeDomainForces<float>(params, acc, moved);
+                break;
+            }
+        }
+
+        // Forces are accelerations for unit masses only
+        if(!m_unitMass)
+        {
+            const int* type = m_particles.type;
+            for(int i = 0; i < n; ++i)
+            {
+                const double invMass = m_invMass[type[i]];
+                acc.x[i] *= invMass;
+                acc.y[i] *= invMass;
+                acc.z[i] *= invMass;
+            }
+        }
+        return sums;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Evaluate the Verlet list with the vectorized kernel for the selected instruction set.
+    // Single precision runs on float working copies of the positions and forces. Mixed precision (C = float)
+    // evaluates the pairs in float straight from the double positions, into the double forces.
+    // With a thread pool, the list must be a full list: each thread only writes to its own range of atoms.
+    // The accelerations end up in out. Returns the potential energy and virial.
+    template<class T, class C>
+    PairListSums ArgonSimulation::computePairListForces(const PairParams& params, PairBand band, Vec3StreamT<T>& pos, Vec3StreamT<T>& acc,
+        Vec3Stream& out, ThreadPool* pool)
+    {
+        const int n = numAtoms();
+        if constexpr(!std::is_same_v<T, double>)
+        {
+            for(int i = 0; i < n; ++i)
+            {
+                pos.x[i] = T(m_particles.pos.x[i]);
+                pos.y[i] = T(m_particles.pos.y[i]);
+                pos.z[i] = T(m_particles.pos.z[i]);
+                acc.x[i] = acc.y[i] = acc.z[i] = 0;
+            }
+        }
+
+        PairListArgs<T, C> args;
+        args.x = pos.x;
+        args.y = pos.y;
+        args.z = pos.z;
+        args.ax = acc.x;
+        args.ay = acc.y;
+        args.az = acc.z;
+        // Rows are ordered by band, see VerletList
+        args.begins = band == PairBand::Outer ? m_neighbors.outerBegins() : m_neighbors.offsets();
+        args.ends = band == PairBand::Inner ? m_neighbors.innerEnds() : m_neighbors.offsets() + 1;
+        args.neighbors = m_neighbors.neighborIndices();
+        args.iBegin = 0;
+        args.iEnd = n;
+        args.types = pairTypes();
+        const PairForm form = setPairArgs(params, band, args);
+        const auto kernel = kernelsFor<T, C>(config.simdLevel).get(!pool, args.types != nullptr, form, band);
+        PairListSums sums;
+        if(pool)
+        {
+            // Fixed blocks of atoms, summed in order, so the sums don't depend on the thread count either.
+            // Full lists visit each pair twice.
+            constexpr int BlockSize = 64;
+            const int numBlocks = (n + BlockSize - 1) / BlockSize;
+            m_blockSums.resize(numBlocks);
+            pool->parallelFor(numBlocks, [&](int begin, int end) {
+                auto range = args;
+                for(int b = begin; b < end; ++b)
+                {
+                    range.iBegin = b * BlockSize;
+                    range.iEnd = std::min(n, range.iBegin + BlockSize);
+                    m_blockSums[b] = kernel(range);
+                }
+            });
+            for(int b = 0; b < numBlocks; ++b)
+            {
+                sums.energy += m_blockSums[b].energy;
+                sums.virial += m_blockSums[b].virial;
+            }
+            sums.energy *= 0.5;
+            sums.virial *= 0.5;
+        }
+        else
+        {
+            sums = kernel(args);
+        }
+
+        if constexpr(!std::is_same_v<T, double>)
+        {
+            for(int i = 0; i < n; ++i)
+            {
+                out.x[i] = acc.x[i];
+                out.y[i] = acc.y[i];
+                out.z[i] = acc.z[i];
+            }
+        }
+        return sums;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Box, pair coefficients, band switch and potential table of the kernel arguments. Returns the pair form to evaluate.
+    template<class T, class C>
+    PairForm ArgonSimulation::setPairArgs(const PairParams& params, PairBand band, PairListArgs<T, C>& args) const
+    {
+        args.boxSize = T(params.box.size);
+        args.imageScale = T(params.box.imageScale);
+        const auto& coefficients = params.coefficients->get(C());
+        args.numTypes = params.coefficients->numTypes();
+        args.c12 = coefficients.c12.data();
+        args.c6 = coefficients.c6.data();
+        args.cutoff2 = coefficients.cutoff2.data();
+        args.forceShift = coefficients.forceShift.data();
+        args.energyShift = coefficients.energyShift.data();
+        if(band != PairBand::All)
+        {
+            const ListBands bands = forceBands();
+            args.switchStart = C(bands.switchStart);
+            args.invSwitchWidth = C(1 / std::max(bands.switchEnd - bands.switchStart, 1e-6));
+        }
+        PairForm form = config.shiftedForce ? PairForm::ShiftedForce : PairForm::LennardJones;
+        if(const PairTable* table = params.table)
+        {
+            form = PairForm::Tabulated;
+            if constexpr(std::is_same_v<C, double>)
+                args.table = table->coefficients();
+            else
+                args.table = table->coefficientsf();
+            args.tableOffsets = table->offsets();
+            args.tableIntervals = table->numIntervals();
+            args.tableStart = C(table->start());
+            args.tableInvSpacing = C(table->invSpacing());
+        }
+        return form;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Full lists of each domain over its owned and ghost atoms, with the kernel for the selected instruction set
+    // at the coefficient precision C. Positions and sums stay in double.
+    template<class C>
+    PairListSums ArgonSimulation::computeDomainForces(const PairParams& params, Vec3Stream& acc, bool moved)
+    {
+        const int numDomains = std::max(1, config.numThreads);
+        if(!m_domains || m_domains->numDomains() != numDomains || m_domains->pinsThreads() != config.pinThreads)
+            m_domains = std::make_unique<DomainDecomposition>(numDomains, config.pinThreads);
+
+        PairListArgs<double, C> prototype;
+        const PairForm form = setPairArgs(params, PairBand::All, prototype);
+        const int* types = pairTypes();
+        const auto kernel = kernelsFor<double, C>(config.simdLevel).get(false, types != nullptr, form, PairBand::All);
+        return m_domains->computeForces(m_particles.pos, types, numSpecies(), acc, numAtoms(), params.box, config.cutoff,
+            config.skin, moved, [&](const DomainAtoms& atoms) {
+                auto args = prototype;
+                args.x = atoms.x;
+                args.y = atoms.y;
+                args.z = atoms.z;
+                args.ax = atoms.ax;
+                args.ay = atoms.ay;
+                args.az = atoms.az;
+                args.types = types ? atoms.types : nullptr;
+                args.begins = atoms.neighbors->offsets();
+                args.ends = atoms.neighbors->offsets() + 1;
+                args.neighbors = atoms.neighbors->neighborIndices();
+                args.iBegin = 0;
+                args.iEnd = atoms.numOwned;
+                return kernel(args);
+            });
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Pair force between atoms i and j, skipped beyond the cutoff of their species. Adds the pair energy and virial to sums.
+    void ArgonSimulation::addPairForce(const PairParams& params, int i, int j, PairListSums& sums)
+    {
+        auto& pos = m_particles.pos;
+        auto& acc = m_particles.acc;
+        const int ti = m_particles.type[i];
+        const int tj = m_particles.type[j];
+        const int pair = params.coefficients->index(ti, tj);
+        // Compute the force exerted by j into i, from its nearest image
+        const double dx = params.box.minimumImage(pos.x[j] - pos.x[i]);
+        const double dy = params.box.minimumImage(pos.y[j] - pos.y[i]);
+        const double dz = params.box.minimumImage(pos.z[j] - pos.z[i]);
+        const double rij2 = dx * dx + dy * dy + dz * dz;
+        if(rij2 >= params.coefficients->cutoff2(pair))
+            return;
+        double f, e;
+        if(params.table)
+            params.table->evaluate(ti, tj, rij2, f, e);
+        else
+            params.coefficients->evaluate(pair, rij2, f, e);
+        // Forces, scaled into accelerations by computeAccelerations
+        acc.x[i] -= f * dx;
+        acc.y[i] -= f * dy;
+        acc.z[i] -= f * dz;
+        acc.x[j] += f * dx;
+        acc.y[j] += f * dy;
+        acc.z[j] += f * dz;
+        sums.energy += e;
+        sums.virial += f * rij2;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Histogram the pairs within the cutoff, reusing the structure the force backend just built.
+    // Each pair is counted once: half lists as they are, full lists only from the lower index.
+    void ArgonSimulation::sampleRadialDistribution()
+    {
+        const int n = numAtoms();
+        const double rMax = config.cutoff;
+        const int numBins = std::max(1, config.rdfBins);
+        if(numBins != m_rdf.numBins() || rMax != m_rdf.rMax())
+            m_rdf.reset(numBins, rMax);
+
+        const PeriodicBox b = box();
+        const auto& pos = m_particles.pos;
+        auto distance2 = [&](int i, int j) {
+            const double dx = b.minimumImage(pos.x[j] - pos.x[i]);
+            const double dy = b.minimumImage(pos.y[j] - pos.y[i]);
+            const double dz = b.minimumImage(pos.z[j] - pos.z[i]);
+            return dx * dx + dy * dy + dz * dz;
+        };
+        switch(config.forceBackend)
+        {
+            case ForceBackend::BruteForce:
+            {
+                m_rdf.reserveThreads(1);
+                for(int i = 0; i < n; ++i)
+                {
+                    for(int j = 0; j < i; ++j)
+                        m_rdf.add(0, distance2(i, j));
+                }
+                break;
+            }
+            case ForceBackend::Domains:
+                // Pairs are only listed within domains: bin the atoms over the whole box
+                m_cells.build(pos, n, b, rMax, pairTypes(), numSpecies());
+                [[fallthrough]];
+            case ForceBackend::CellList:
+            {
+                m_rdf.reserveThreads(1);
+                m_cells.forEachPair([&](int i, int j) { m_rdf.add(0, distance2(i, j)); });
+                break;
+            }
+            case ForceBackend::VerletList:
+            case ForceBackend::Threaded:
+            {
+                const int* neighbors = m_neighbors.neighborIndices();
+                const bool fullList = config.forceBackend == ForceBackend::Threaded;
+                auto sampleRange = [&](int thread, int begin, int end) {
+                    for(int i = begin; i < end; ++i)
+                    {
+                        for(int k = m_neighbors.neighborsBegin(i); k < m_neighbors.neighborsEnd(i); ++k)
+                        {
+                            const int j = neighbors[k];
+                            if(!fullList || j > i)
+                                m_rdf.add(thread, distance2(i, j));
+                        }
+                    }
+                };
+                if(fullList && m_pool)
+                {
+                    m_rdf.reserveThreads(m_pool->size());
+                    m_pool->parallelFor(n, sampleRange);
+                }
+                else
+                {
+                    m_rdf.reserveThreads(1);
+                    sampleRange(0, 0, n);
+                }
+                break;
+            }
+        }
+        m_rdf.endSample(n, volume());
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Closing half kick of a step of length h with the accelerations acc. The thermostat and barostat, if any,
+    // are folded into the same loop, which also accumulates the kinetic energy for the next step's thermostat.
+    // The barostat's box rescaling is deferred to the next position update.
+    void ArgonSimulation::updateSpeeds(double h, const Vec3Stream& acc)
+    {
+        if(config.thermostat != m_thermostatKind)
+        {
+            m_thermostat = makeThermostat(config.thermostat);
+            m_thermostatKind = config.thermostat;
+        }
+        if(config.barostat != m_barostatKind)
+        {
+            m_barostat = makeBarostat(config.barostat);
+            m_barostatKind = config.barostat;
+        }
+        VelocityUpdate update;
+        if(m_thermostat)
+            update = m_thermostat->begin(config.thermostatParams, m_kineticEnergy, degreesOfFreedom(), h);
+        BoxUpdate boxUpdate;
+        if(m_barostat && config.periodic && !config.freeze)
+        {
+            boxUpdate = m_barostat->begin(config.barostatParams, pressure(), volume(), m_kineticEnergy, degreesOfFreedom(),
+                config.thermostatParams.temperature, h);
+        }
+        m_boxScale *= boxUpdate.lengthScale;
+
+        auto& vel = m_particles.vel;
+        const int* type = m_particles.type;
+        const double* mass = m_mass.data();
+        const int n = numAtoms();
+        const double vs = update.velocityScale * boxUpdate.velocityScale;
+        const double fs = update.forceScale * h / 2;
+        double sumMV2 = 0;
+        if(update.noise == 0)
+        {
+            for(int i = 0; i < n; ++i)
+            {
+                vel.x[i] = vs * vel.x[i] + fs * acc.x[i];
+                vel.y[i] = vs * vel.y[i] + fs * acc.y[i];
+                vel.z[i] = vs * vel.z[i] + fs * acc.z[i];
+                sumMV2 += mass[type[i]] * (vel.x[i] * vel.x[i] + vel.y[i] * vel.y[i] + vel.z[i] * vel.z[i]);
+            }
+        }
+        else
+        {
+            // Random kicks are generated a block at a time, so they stay in L1 until consumed
+            alignas(64) double gx[CounterRandom::BlockSize];
+            alignas(64) double gy[CounterRandom::BlockSize];
+            alignas(64) double gz[CounterRandom::BlockSize];
+            const double noise = update.noise;
+            const CounterRandom rng(uint32_t(config.seed), LangevinStream);
+            for(int begin = 0; begin < n; begin += CounterRandom::BlockSize)
+            {
+                const int count = std::min(CounterRandom::BlockSize, n - begin);
+                rng.gaussians3(m_particles.id + begin, count, m_stepCount, gx, gy, gz);
+                for(int k = 0; k < count; ++k)
+                {
+                    const int i = begin + k;
+                    const double sd = noise * m_invSqrtMass[type[i]];
+                    vel.x[i] = vs * vel.x[i] + fs * acc.x[i] + sd * gx[k];
+                    vel.y[i] = vs * vel.y[i] + fs * acc.y[i] + sd * gy[k];
+                    vel.z[i] = vs * vel.z[i] + fs * acc.z[i] + sd * gz[k];
+                    sumMV2 += mass[type[i]] * (vel.x[i] * vel.x[i] + vel.y[i] * vel.y[i] + vel.z[i] * vel.z[i]);
+                }
+            }
+        }
+        m_kineticEnergy = 0.5 * sumMV2;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    Observables ArgonSimulation::sampleObservables() const
+    {
+        Observables o;
+        o.step = m_stepCount;
+        o.time = m_time;
+        o.kineticEnergy = m_kineticEnergy;
+        o.potentialEnergy = m_potentialEnergy;
+        o.extendedEnergy = extendedEnergy();
+        o.virial = m_virial;
+        o.temperature = temperature();
+        o.pressure = pressure();
+        o.volume = volume();
+        return o;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double ArgonSimulation::extendedEnergy() const
+    {
+        double energy = 0;
+        if(m_thermostat)
+            energy += m_thermostat->energy(config.thermostatParams, degreesOfFreedom());
+        if(m_barostat)
+            energy += m_barostat->energy(config.barostatParams, volume());
+        return energy;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double ArgonSimulation::computeKineticEnergy() const
+    {
+        const auto& vel = m_particles.vel;
+        const int* type = m_particles.type;
+        double sumMV2 = 0;
+        for(int i = 0; i < numAtoms(); ++i)
+            sumMV2 += m_mass[type[i]] * (vel.x[i] * vel.x[i] + vel.y[i] * vel.y[i] + vel.z[i] * vel.z[i]);
+        return 0.5 * sumMV2;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    Vec3d ArgonSimulation::scatterPosition(int id) const
+    {
+        const auto u = CounterRandom(uint32_t(config.seed), ScatterStream).uniform4<double>(uint32_t(id), 0);
+        const double boxSize = m_boxSize;
+        return Vec3d((u[0] - 0.5) * boxSize, (u[1] - 0.5) * boxSize, (u[2] - 0.5) * boxSize);
+    }
+}
@@ -0,0 +1,258 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <math/vector.h>
+#include "atomBuffer.h"
+#include "barostat.h"
+#include "cellList.h"
+#include "checkpoint.h"
+#include "domainDecomposition.h"
+#include "ljKernel.h"
+#include "multiTauCorrelator.h"
+#include "observables.h"
+#include "pairTable.h"
+#include "periodicBox.h"
+#include "radialDistribution.h"
+#include "spaceFillingCurve.h"
+#include "species.h"
+#include "thermostat.h"
+#include "threadPool.h"
+#include "verletList.h"
+
+namespace md
+{
+    // Lennard-Jones fluid of one or more species, in the reduced units of the first one (epsilon = sigma = m = 1),
+    // integrated with velocity Verlet, or with r-RESPA multiple time steps when config.respaSteps > 1.
+    // The box starts at config.boxSize and may be resized by the barostat.
+    // Independent of any front end, so it can be driven by the viewer or by headless tools.
+    class ArgonSimulation
+    {
+    public:
+        // Strategy used to find interacting pairs. All of them produce the same set of pairs within the cutoff.
+        enum class ForceBackend : int
+        {
+            BruteForce, // O(N^2) loop over every pair
+            CellList, // O(N) linked cells of size >= cutoff
+            VerletList, // Cached neighbor lists within cutoff + skin, rebuilt on demand
+            Threaded, // Full Verlet lists split across threads. Bitwise identical results for any thread count.
+            Domains // Spatial domains, one per thread, exchanging ghosts and migrating atoms through rings
+        };
+
+        // Initial placement of the atoms
+        enum class InitialPositions : int
+        {
+            Scatter, // Uniformly random. Overlapping pairs start with huge forces.
+            FCC // Face centered cubic lattice filling the box, the solid phase of argon. No close pairs.
+        };
+
+        struct Config
+        {
+            // Read at construction. Use resize() to change the number of atoms afterwards.
+            int numAtoms = 15;
+            double boxSize = 10;
+            double density = 0; // Atoms per unit volume. When > 0, the box is sized for it instead of using boxSize.
+            int seed = 0; // Key of the random streams: initial scatter, velocities, species and Langevin kicks
+            InitialPositions initialPositions = InitialPositions::Scatter;
+            double initialTemperature = 0; // Maxwell-Boltzmann velocities at this temperature. 0 starts at rest.
+            // Atom species, drawn at random for each atom in proportion to their fractions.
+            // Empty for a single species of epsilon = sigma = m = 1. Their parameters can be changed between steps.
+            std::vector<Species> species;
+
+            // Can be changed between steps
+            double timeStep = 5e-3; // Dimensionless time step. With r-RESPA, the outer time step.
+            // r-RESPA: Verlet list backends split pair forces at respaCutoff into a fast inner part, integrated
+            // in respaSteps sub-steps, and a slow outer part, evaluated once per time step.
+            // The split is smoothed over respaSwitch below respaCutoff. respaSteps = 1 disables the split.
+            int respaSteps = 1;
+            float respaCutoff = 1.6f;
+            float respaSwitch = 0.3f;
+            bool freeze = false; // Keep atoms in place, only update forces and velocities
+            bool periodic = true; // Periodic boundary conditions, with minimum image pair separations. Otherwise the faces are reflecting walls.
+            ForceBackend forceBackend = ForceBackend::CellList;
+            float cutoff = 2.5f; // Interaction cutoff radius, in units of sigma
+            float skin = 0.3f; // Verlet list margin beyond the cutoff
+            bool shiftedForce = false; // Shift the force to go smoothly to zero at the cutoff
+            // Pairs of species with their own parameters or a shorter cutoff, instead of the mixing rules
+            std::vector<PairOverride> pairOverrides;
+            // Tabulated pair potentials, evaluated instead of the built-in Lennard-Jones when set, with one type per species.
+            // Interactions end at the smaller of the two cutoffs. shiftedForce doesn't apply: it's chosen per table.
+            std::shared_ptr<const PairTable> pairTable;
+            SimdLevel simdLevel = detectSimdLevel(); // Instruction set of the Verlet list kernel
+            PairPrecision precision = PairPrecision::Double; // Of the Verlet list force evaluation
+            int numThreads = std::max(1, int(std::thread::hardware_concurrency())); // Threads (or domains) of the threaded backends
+            // Pin each domain thread to a CPU the process may use, filling one NUMA node after the other.
+            // The calling thread runs the first domain and is only pinned while forces are computed.
+            bool pinThreads = false;
+            int reorderInterval = 0; // Minimum steps between spatial reorders of the atoms in memory. 0 disables reordering.
+            SpaceFillingCurve reorderCurve = SpaceFillingCurve::Hilbert;
+            ThermostatKind thermostat = ThermostatKind::None;
+            ThermostatParams thermostatParams;
+            BarostatKind barostat = BarostatKind::None; // Only applies to periodic boxes
+            BarostatParams barostatParams;
+            int observableInterval = 1; // Steps between pushes to observables(). 0 disables publishing.
+            int rdfInterval = 0; // Steps between samples of the radial distribution function. 0 disables sampling.
+            int rdfBins = 100; // Histogram bins of g(r), up to the cutoff
+            int correlatorInterval = 0; // Steps between samples of the MSD and VACF correlators. 0 disables them.
+            int correlatorLevels = 16; // Multiple-tau levels, each doubling the longest lag
+        };
+
+        ArgonSimulation() : ArgonSimulation(Config()) {}
+        explicit ArgonSimulation(const Config& config);
+
+        void scatterParticles();
+        // Place the atoms on the sites of an FCC lattice of n^3 unit cells filling the box, the smallest with enough sites.
+        // Sites are filled cell by cell, so neighbors in space also start close in memory.
+        void placeOnLattice();
+        // Draw velocities from the Maxwell-Boltzmann distribution, remove the net momentum,
+        // and rescale to exactly the given temperature.
+        void seedVelocities(double temperature);
+        // Draw the species of every atom from config.species, in proportion to their fractions.
+        // A pure function of the seed and the atom ids.
+        void assignSpecies();
+        // Keep the first min(numAtoms(), numAtoms) atoms and scatter any new ones, with random species
+        void resize(int numAtoms);
+        void step();
+        // Sort atoms in memory along config.reorderCurve, by the cell they are in, so neighbors in space are close in memory.
+        // Slot indices change, particles().id keeps track of the original atoms.
+        void reorderAtoms();
+
+        int numAtoms() const { return m_particles.size(); }
+        int numSpecies() const { return m_pairCoefficients.numTypes(); }
+        // Lennard-Jones coefficients of every pair of species, as of the last step
+        const PairCoefficients& pairCoefficients() const { return m_pairCoefficients; }
+        uint64_t stepCount() const { return m_stepCount; }
+        // Translational degrees of freedom, without the conserved total momentum
+        int degreesOfFreedom() const { return numAtoms() > 1 ? 3 * numAtoms() - 3 : 3 * numAtoms(); }
+        double kineticEnergy() const { return m_kineticEnergy; }
+        double temperature() const { return 2 * m_kineticEnergy / std::max(1, degreesOfFreedom()); }
+        // Pair energy of the last force evaluation, shifted to vanish at the cutoff
+        double potentialEnergy() const { return m_potentialEnergy; }
+        double totalEnergy() const { return m_kineticEnergy + m_potentialEnergy; }
+        // Pair virial sum r . F of the last force evaluation
+        double virial() const { return m_virial; }
+        // Virial pressure P = (2 KE + W) / 3V, without long range corrections beyond the cutoff
+        double pressure() const { return (2 * m_kineticEnergy + m_virial) / (3 * volume()); }
+        double boxSize() const { return m_boxSize; }
+        double volume() const { return m_boxSize * m_boxSize * m_boxSize; }
+        // Thermostat and barostat energy, to be added to the total energy for conserved quantity checks
+        double extendedEnergy() const;
+        const AtomBuffer& particles() const { return m_particles; }
+        PeriodicBox box() const { return PeriodicBox(m_boxSize, config.periodic); }
+        bool usesNeighborList() const
+        {
+            return config.forceBackend == ForceBackend::VerletList || config.forceBackend == ForceBackend::Threaded;
+        }
+        bool usesMultipleTimeStep() const
+        {
+            return config.respaSteps > 1 && usesNeighborList() && config.respaCutoff < config.cutoff;
+        }
+
+        VerletList& neighbors() { return m_neighbors; }
+        const VerletList& neighbors() const { return m_neighbors; }
+        // Domains of the domain backend, null with other backends or before its first step
+        const DomainDecomposition* domains() const { return m_domains.get(); }
+        uint64_t numReorders() const { return m_numReorders; }
+        // Snapshot of the thermodynamic state, and the queue step() publishes it to every config.observableInterval steps
+        Observables sampleObservables() const;
+        ObservableRing& observables() { return m_observables; }
+        // g(r) up to the cutoff, sampled every config.rdfInterval steps from the pairs the force backend visits
+        RadialDistribution& radialDistribution() { return m_rdf; }
+        // Mean squared displacement of the unwrapped positions and velocity autocorrelation,
+        // sampled every config.correlatorInterval steps. Lags are in units of that interval.
+        const MultiTauCorrelator& meanSquaredDisplacement() const { return m_msd; }
+        const MultiTauCorrelator& velocityAutocorrelation() const { return m_vacf; }
+        void resetCorrelators();
+
+        // Save the dynamic state (atoms, box, step, thermostat, barostat and generator state) through writer,
+        // which finishes writing in the background. The config isn't saved: restart with the same one.
+        // Neighbor lists are rebuilt on the next step, as after loading, so a restarted run is bitwise identical to this one.
+        // False, without writing, if the thermostat or barostat state doesn't fit in a checkpoint header.
+        bool saveCheckpoint(CheckpointWriter& writer, const std::string& path);
+        // Restore a state saved by saveCheckpoint. False, with the simulation unchanged, if the file can't be used,
+        // or was saved with another number of species or another cutoff.
+        bool loadCheckpoint(const std::string& path);
+
+        Config config;
+
+    private:
+        struct PairParams
+        {
+            PeriodicBox box;
+            const PairCoefficients* coefficients; // Cutoffs and Lennard-Jones parameters of each pair of species
+            const PairTable* table; // Tabulated potentials, or null for Lennard-Jones
+        };
+
+        // Pair coefficients and masses of the species in the config
+        void updateSpecies();
+        int drawSpecies(int id) const;
+        // Types to sort and look up pairs by, null with a single species
+        const int* pairTypes() const { return numSpecies() > 1 ? m_particles.type : nullptr; }
+        // Neighbor list bands of the r-RESPA force split, disabled without it
+        ListBands forceBands() const;
+        bool neighborListRebuildDue() const;
+        void kick(const Vec3Stream& acc, double h);
+        void updatePositions(double h, double kickStep);
+        void computeInitialForces();
+        PairListSums computeAccelerations(PairBand band);
+        template<class T, class C = T>
+        PairListSums computePairListForces(const PairParams& params, PairBand band, Vec3StreamT<T>& pos, Vec3StreamT<T>& acc,
+            Vec3Stream& out, ThreadPool* pool);
+        template<class T, class C>
+        PairForm setPairArgs(const PairParams& params, PairBand band, PairListArgs<T, C>& args) const;
+        template<class C>
+        PairListSums computeDomainForces(const PairParams& params, Vec3Stream& acc, bool moved);
+        void addPairForce(const PairParams& params, int i, int j, PairListSums& sums);
+        void updateSpeeds(double h, const Vec3Stream& acc);
+        void sampleRadialDistribution();
+        void sampleCorrelators();
+        double computeKineticEnergy() const;
+
+        // Uniformly random position in the box, a pure function of the seed and the atom id
+        math::Vec3d scatterPosition(int id) const;
+
+        double m_boxSize;
+        double m_boxScale = 1; // Pending barostat rescaling, applied by the next position update
+        AtomBuffer m_particles;
+        PairCoefficients m_pairCoefficients;
+        // Per species mass, its inverse and inverse square root
+        std::vector<double> m_mass;
+        std::vector<double> m_invMass;
+        std::vector<double> m_invSqrtMass;
+        bool m_unitMass = true; // Forces are accelerations
+
+        CellList m_cells;
+        VerletList m_neighbors;
+        double m_maxDisplacement2 = 0; // Largest squared displacement since the neighbor list was built
+        // The accelerations are those of the current positions, split along m_forceBands
+        bool m_forcesCurrent = false;
+        ListBands m_forceBands;
+        std::unique_ptr<ThreadPool> m_pool;
+        std::unique_ptr<DomainDecomposition> m_domains;
+
+        uint64_t m_stepCount = 0;
+        double m_time = 0; // Simulated time, the sum of the time steps taken
+        double m_kineticEnergy = 0; // Of the current velocities, accumulated by updateSpeeds
+        ThermostatKind m_thermostatKind = ThermostatKind::None;
+        std::unique_ptr<Thermostat> m_thermostat;
+        double m_potentialEnergy = 0;
+        double m_virial = 0;
+        ObservableRing m_observables;
+        RadialDistribution m_rdf;
+        MultiTauCorrelator m_msd;
+        MultiTauCorrelator m_vacf;
+        BarostatKind m_barostatKind = BarostatKind::None;
+        std::unique_ptr<Barostat> m_barostat;
+        std::vector<PairListSums> m_blockSums; // Per block partial sums of the threaded kernel
+
+        int m_stepsSinceReorder = 0;
+        uint64_t m_numReorders = 0;
+        std::vector<uint64_t> m_sortKeys;
+        std::vector<int> m_order;
+    };
+}
@@ -0,0 +1,332 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <math/vector.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace md
+{
+    // Alignment and padding of every per-atom stream. 64 bytes fits a cache line and a full AVX-512 register,
+    // so SIMD kernels can use aligned loads and run whole lanes past the last atom.
+    static constexpr size_t StreamAlignment = 64;
+    static constexpr int SimdPadding = StreamAlignment / sizeof(double);
+
+    // Arenas at least this big are aligned to, and sized in multiples of, a transparent huge page,
+    // so large systems need far fewer TLB entries to stream through their atoms.
+    static constexpr size_t HugePageSize = size_t(2) << 20;
+
+    // Three separate, aligned scalar streams for a per-atom vector quantity (structure of arrays)
+    template<class T>
+    struct Vec3StreamT
+    {
+        T* x = nullptr;
+        T* y = nullptr;
+        T* z = nullptr;
+
+        // Byte distance between consecutive elements of a component, for strided consumers such as ImPlot
+        static constexpr int Stride = sizeof(T);
+
+        T* component(int axis) const
+        {
+            return axis == 0 ? x : (axis == 1 ? y : z);
+        }
+
+        math::Vec3d operator[](int i) const
+        {
+            return { x[i], y[i], z[i] };
+        }
+
+        void set(int i, const math::Vec3d& v)
+        {
+            x[i] = T(v.x());
+            y[i] = T(v.y());
+            z[i] = T(v.z());
+        }
+    };
+
+    using Vec3Stream = Vec3StreamT<double>;
+    using Vec3Streamf = Vec3StreamT<float>;
+
+    // Structure of arrays particle storage. Each component of each quantity is its own stream,
+    // padded to a multiple of SimdPadding elements. Padding elements are zero and never simulated.
+    // All streams are carved from a single arena, which only reallocates when the atom count outgrows its capacity.
+    // Atoms may be reordered in memory (see permute), so each one carries a stable id.
+    class AtomBuffer
+    {
+    public:
+        explicit AtomBuffer(int numAtoms, int capacity = 0)
+        {
+            reserve(std::max(numAtoms, capacity));
+            resize(numAtoms);
+        }
+
+        ~AtomBuffer()
+        {
+            releaseArena();
+        }
+
+        AtomBuffer(const AtomBuffer&) = delete;
+        AtomBuffer& operator=(const AtomBuffer&) = delete;
+
+        int size() const { return m_size; }
+        int paddedSize() const { return padded(m_size); }
+        int capacity() const { return m_capacity; }
+        size_t arenaBytes() const { return m_arenaBytes; }
+        // Every id in use is below this bound
+        int idBound() const { return m_nextId; }
+
+        // Change the number of atoms, keeping the state of the first min(size, numAtoms) ones.
+        // New atoms start zeroed. Grows geometrically, so repeated growth is amortized.
+        // New atoms get fresh ids.
+        void resize(int numAtoms)
+        {
+            if(numAtoms > m_capacity)
+                reserve(std::max(numAtoms, m_capacity + m_capacity / 2));
+            else if(numAtoms < m_size)
+                clear(numAtoms, m_size); // Restore zero padding past the new size
+            for(int i = m_size; i < numAtoms; ++i)
+                id[i] = m_nextId++;
+            m_size = numAtoms;
+        }
+
+        // Make room for at least numAtoms atoms without further allocations
+        void reserve(int numAtoms)
+        {
+            if(numAtoms > m_capacity || !m_arena)
+                reallocate(padded(numAtoms));
+        }
+
+        // Release capacity beyond the current size
+        void shrinkToFit()
+        {
+            if(padded(m_size) < m_capacity)
+                reallocate(padded(m_size));
+        }
+
+        // Bytes of an arena laid out for capacity atoms
+        size_t layoutBytes(int capacity) const
+        {
+            size_t bytes = 0;
+            forEachStream([&](auto& stream) {
+                bytes += 3 * streamBytes<std::remove_pointer_t<decltype(stream.x)>>(capacity);
+            });
+            return bytes + 2 * streamBytes<int>(capacity);
+        }
+
+        // Copy every stream into dest, laid out as an arena with capacity paddedSize(). dest must hold layoutBytes(paddedSize()).
+        // The copy can be adopted back as is (see adoptArena).
+        void copyArena(char* dest) const
+        {
+            const int capacity = paddedSize();
+            auto copyStream = [&](const auto* data) {
+                using T = std::remove_const_t<std::remove_pointer_t<decltype(data)>>;
+                const size_t bytes = capacity * sizeof(T);
+                std::memcpy(dest, data, bytes);
+                std::memset(dest + bytes, 0, streamBytes<T>(capacity) - bytes);
+                dest += streamBytes<T>(capacity);
+            };
+            forEachStream([&](auto& stream) {
+                for(int axis = 0; axis < 3; ++axis)
+                    copyStream(stream.component(axis));
+            });
+            copyStream(id);
+            copyStream(type);
+        }
+
+        // Take over an arena produced by copyArena for numAtoms atoms, such as a memory mapped checkpoint, without copying it.
+        // release is called instead of the default deallocation once the buffer is done with the arena.
+        void adoptArena(char* arena, size_t bytes, int numAtoms, int nextId, std::function<void()> release)
+        {
+            releaseArena();
+            const int capacity = padded(numAtoms);
+            carveStreams(arena, capacity, 0);
+            m_arena = arena;
+            m_arenaBytes = bytes;
+            m_release = std::move(release);
+            m_capacity = capacity;
+            m_size = numAtoms;
+            m_nextId = nextId;
+        }
+
+        // Type stream of an arena produced by copyArena for numAtoms atoms, to vet it before adopting it
+        const int* arenaTypes(const char* arena, int numAtoms) const
+        {
+            const int capacity = padded(numAtoms);
+            return reinterpret_cast<const int*>(arena + layoutBytes(capacity) - streamBytes<int>(capacity));
+        }
+
+        // Move the atom in slot order[i] to slot i, for every i < size(). order must be a permutation of [0, size()).
+        // Streams are permuted in place through a reusable scratch stream.
+        // The float working copies are skipped: they are refreshed from pos before every use.
+        void permute(const int* order)
+        {
+            m_scratch.resize(m_capacity);
+            m_intScratch.resize(m_capacity);
+            for(auto* stream : { &pos, &vel, &acc, &accOuter, &unwrapped })
+            {
+                for(double* component : { stream->x, stream->y, stream->z })
+                    gather(component, order, m_scratch.data());
+            }
+            gather(id, order, m_intScratch.data());
+            gather(type, order, m_intScratch.data());
+        }
+
+        Vec3Stream pos;
+        Vec3Stream vel;
+        Vec3Stream acc;
+        // Slow part of the acceleration, when the pair forces are split between multiple time steps
+        Vec3Stream accOuter;
+        // Positions without the periodic wrap, for displacements over many box lengths
+        Vec3Stream unwrapped;
+
+        // Single precision working copies for the float pair kernels
+        Vec3Streamf posf;
+        Vec3Streamf accf;
+
+        // Original id of the atom in each slot. Unique, and equal to the slot index until atoms are reordered.
+        int* id = nullptr;
+        // Species of each atom, indexing the per type tables of the simulation. New atoms are of type 0.
+        int* type = nullptr;
+
+        // Stream length for numAtoms atoms, rounded up to whole SIMD registers
+        static int padded(int numAtoms)
+        {
+            return (numAtoms + SimdPadding - 1) / SimdPadding * SimdPadding;
+        }
+
+    private:
+        // Apply op to every stream of the buffer, in arena order
+        template<class Self, class Op>
+        static void forEachStreamOf(Self& self, Op&& op)
+        {
+            for(auto* stream : { &self.pos, &self.vel, &self.acc, &self.accOuter, &self.unwrapped })
+                op(*stream);
+            for(auto* stream : { &self.posf, &self.accf })
+                op(*stream);
+        }
+
+        template<class Op>
+        void forEachStream(Op&& op) { forEachStreamOf(*this, op); }
+        template<class Op>
+        void forEachStream(Op&& op) const { forEachStreamOf(*this, op); }
+
+        template<class T>
+        void gather(T* data, const int* order, T* scratch) const
+        {
+            for(int i = 0; i < m_size; ++i)
+                scratch[i] = data[order[i]];
+            std::copy_n(scratch, m_size, data);
+        }
+
+        // Byte size of one component stream of T with room for capacity atoms, keeping the next stream aligned
+        template<class T>
+        static size_t streamBytes(int capacity)
+        {
+            return (capacity * sizeof(T) + StreamAlignment - 1) / StreamAlignment * StreamAlignment;
+        }
+
+        void reallocate(int capacity)
+        {
+            size_t bytes = layoutBytes(capacity);
+            if(bytes >= HugePageSize)
+                bytes = (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+            char* arena = allocateArena(bytes);
+
+            // Carve the streams out of the new arena, and carry over live atoms. Everything else is zero.
+            std::memset(arena, 0, bytes);
+            const int numLive = std::min(m_size, capacity);
+            carveStreams(arena, capacity, m_arena ? numLive : 0);
+
+            releaseArena();
+            m_arena = arena;
+            m_arenaBytes = bytes;
+            m_capacity = capacity;
+            m_size = numLive;
+        }
+
+        // Point every stream into an arena laid out for capacity atoms, copying the first numLive atoms of the current streams
+        void carveStreams(char* arena, int capacity, int numLive)
+        {
+            char* cursor = arena;
+            forEachStream([&](auto& stream) {
+                using T = std::remove_pointer_t<decltype(stream.x)>;
+                for(T** component : { &stream.x, &stream.y, &stream.z })
+                {
+                    T* data = reinterpret_cast<T*>(cursor);
+                    std::copy_n(*component, numLive, data);
+                    *component = data;
+                    cursor += streamBytes<T>(capacity);
+                }
+            });
+            for(int** stream : { &id, &type })
+            {
+                int* data = reinterpret_cast<int*>(cursor);
+                std::copy_n(*stream, numLive, data);
+                *stream = data;
+                cursor += streamBytes<int>(capacity);
+            }
+        }
+
+        void releaseArena()
+        {
+            if(m_release)
+                std::exchange(m_release, nullptr)();
+            else
+                freeArena(m_arena, m_arenaBytes);
+            m_arena = nullptr;
+        }
+
+        // Zero atoms [begin, end) in every stream
+        void clear(int begin, int end)
+        {
+            forEachStream([&](auto& stream) {
+                for(int axis = 0; axis < 3; ++axis)
+                    std::fill(stream.component(axis) + begin, stream.component(axis) + end, 0);
+            });
+            std::fill(id + begin, id + end, 0);
+            std::fill(type + begin, type + end, 0);
+        }
+
+        static size_t arenaAlignment(size_t bytes)
+        {
+            return bytes >= HugePageSize ? HugePageSize : StreamAlignment;
+        }
+
+        static char* allocateArena(size_t bytes)
+        {
+            auto* arena = static_cast<char*>(::operator new[](bytes, std::align_val_t(arenaAlignment(bytes))));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            // Only a hint: silently ignored when transparent huge pages are disabled
+            if(bytes >= HugePageSize)
+                madvise(arena, bytes, MADV_HUGEPAGE);
+#endif
+            return arena;
+        }
+
+        static void freeArena(char* arena, size_t bytes)
+        {
+            if(arena)
+                ::operator delete[](arena, std::align_val_t(arenaAlignment(bytes)));
+        }
+
+        char* m_arena = nullptr;
+        size_t m_arenaBytes = 0;
+        std::function<void()> m_release; // Frees an adopted arena
+        int m_size = 0;
+        int m_capacity = 0;
+        int m_nextId = 0;
+        std::vector<double> m_scratch;
+        std::vector<int> m_intScratch;
+    };
+}
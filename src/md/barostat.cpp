@@ -0,0 +1,52 @@
+// Molecular dynamics playground
+#include "barostat.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace md
+{
+    //----------------------------------------------------------------------------------------------
+    BoxUpdate BerendsenBarostat::begin(const BarostatParams& params, double pressure, double, double, int, double, double h)
+    {
+        // Bounded to 1% per step, so a far from equilibrium start doesn't collapse the box
+        BoxUpdate update;
+        const double mu3 = 1 - params.compressibility * h / params.tau * (params.pressure - pressure);
+        update.lengthScale = std::clamp(std::cbrt(std::max(mu3, 0.0)), 0.99, 1.01);
+        return update;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    BoxUpdate MtkBarostat::begin(const BarostatParams& params, double pressure, double volume, double kineticEnergy,
+        int degreesOfFreedom, double temperature, double h)
+    {
+        const double dof = std::max(1, degreesOfFreedom);
+        m_mass = (dof + 3) * temperature * params.tau * params.tau;
+        if(m_mass <= 0)
+            return {};
+        const double force = 3 * volume * (pressure - params.pressure) + 3 / dof * 2 * kineticEnergy;
+        m_velocity += force / m_mass * h;
+
+        BoxUpdate update;
+        update.lengthScale = std::exp(m_velocity * h);
+        update.velocityScale = std::exp(-(1 + 3 / dof) * m_velocity * h);
+        return update;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double MtkBarostat::energy(const BarostatParams& params, double volume) const
+    {
+        return 0.5 * m_mass * m_velocity * m_velocity + params.pressure * volume;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    std::unique_ptr<Barostat> makeBarostat(BarostatKind kind)
+    {
+        switch(kind)
+        {
+            case BarostatKind::Berendsen: return std::make_unique<BerendsenBarostat>();
+            case BarostatKind::MTK: return std::make_unique<MtkBarostat>();
+            default: return nullptr;
+        }
+    }
+}
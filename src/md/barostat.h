@@ -0,0 +1,87 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace md
+{
+    // Built-in pressure control schemes. Both are isotropic: the cubic box stays cubic.
+    enum class BarostatKind : int
+    {
+        None, // Constant volume
+        Berendsen, // Weak coupling box rescaling. Fast to equilibrate the density, but doesn't sample the NPT ensemble.
+        MTK // Martyna-Tobias-Klein extended system, with a box momentum driven by the pressure difference
+    };
+
+    // Target and coupling strength, shared by every barostat. Units are reduced (k_B = epsilon = sigma = m = 1).
+    struct BarostatParams
+    {
+        double pressure = 1;
+        double tau = 1; // Coupling time. Sets the Berendsen relaxation rate and the MTK piston mass.
+        double compressibility = 1; // Isothermal compressibility assumed by Berendsen
+    };
+
+    // Change of the box applied by the integrator.
+    // Coordinates and the box edge are scaled by lengthScale at the next drift, velocities by velocityScale
+    // in the same loop as the force kick (see VelocityUpdate).
+    struct BoxUpdate
+    {
+        double lengthScale = 1;
+        double velocityScale = 1;
+    };
+
+    // Integrator stage that controls the pressure through the box size
+    class Barostat
+    {
+    public:
+        virtual ~Barostat() = default;
+
+        // Box change for the next step, from the pressure of the current configuration.
+        // temperature is the ensemble temperature, used to size the MTK piston mass.
+        virtual BoxUpdate begin(const BarostatParams& params, double pressure, double volume, double kineticEnergy,
+            int degreesOfFreedom, double temperature, double h) = 0;
+
+        // Energy stored in the barostat's own degrees of freedom plus the P V work, for conserved quantity checks
+        virtual double energy(const BarostatParams& params, double volume) const { return params.pressure * volume; }
+
+        // Internal state, for checkpoints
+        virtual std::vector<double> state() const { return {}; }
+        virtual void setState(const std::vector<double>&) {}
+    };
+
+    // mu^3 = 1 - compressibility h/tau (P0 - P)
+    class BerendsenBarostat : public Barostat
+    {
+    public:
+        BoxUpdate begin(const BarostatParams& params, double pressure, double volume, double kineticEnergy,
+            int degreesOfFreedom, double temperature, double h) override;
+    };
+
+    // Isotropic MTK: the log volume strain epsilon has velocity v_eps and mass W = (dof + 3) T tau^2.
+    //   dv_eps/dt = (3 V (P - P0) + 3/dof 2 KE) / W
+    // The box grows as exp(v_eps h) and particle velocities are damped by exp(-(1 + 3/dof) v_eps h).
+    // Combine with a thermostat for NPT, without one it samples NPH.
+    class MtkBarostat : public Barostat
+    {
+    public:
+        BoxUpdate begin(const BarostatParams& params, double pressure, double volume, double kineticEnergy,
+            int degreesOfFreedom, double temperature, double h) override;
+        double energy(const BarostatParams& params, double volume) const override;
+        std::vector<double> state() const override { return { m_mass, m_velocity }; }
+        void setState(const std::vector<double>& state) override
+        {
+            if(state.size() == 2)
+            {
+                m_mass = state[0];
+                m_velocity = state[1];
+            }
+        }
+
+    private:
+        double m_mass = 0; // W, from the last update
+        double m_velocity = 0; // v_eps
+    };
+
+    std::unique_ptr<Barostat> makeBarostat(BarostatKind kind);
+}
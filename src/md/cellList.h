@@ -0,0 +1,183 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <math/vector.h>
+#include "atomBuffer.h"
+#include "periodicBox.h"
+
+namespace md
+{
+    // Linked-cell spatial decomposition of a cubic box centered at the origin.
+    // Atoms are binned into cells at least minCellSize wide and sorted by cell (counting sort),
+    // so every cell's atoms are contiguous in atomIndices(). With atom types, each cell is further sorted by type.
+    // Pairs closer than minCellSize are guaranteed to be in the same or adjacent cells.
+    // In periodic boxes, neighborhoods wrap around the faces of the box.
+    class CellList
+    {
+    public:
+        void build(const Vec3Stream& pos, int numAtoms, const PeriodicBox& box, double minCellSize, const int* types = nullptr,
+            int numTypes = 1)
+        {
+            m_boxSize = box.size;
+            m_periodic = box.periodic;
+            m_cellsPerDim = std::max(1, int(box.size / minCellSize));
+            // Wrapped stencils need 3 distinct cells per dimension, otherwise neighbors alias each other.
+            // Fall back to a single cell, where every pair is visited once.
+            if(m_periodic && m_cellsPerDim < 3)
+                m_cellsPerDim = 1;
+            m_invCellSize = m_cellsPerDim / box.size;
+            m_numTypes = types ? std::max(1, numTypes) : 1;
+            const int numBins = numCells() * m_numTypes;
+
+            // Count atoms per bin, one bin per cell and type
+            m_binStart.assign(numBins + 1, 0);
+            m_atomBin.resize(numAtoms);
+            for(int i = 0; i < numAtoms; ++i)
+            {
+                int bin = cellIndex(cellCoord(pos.x[i]), cellCoord(pos.y[i]), cellCoord(pos.z[i])) * m_numTypes;
+                if(types)
+                    bin += types[i];
+                m_atomBin[i] = bin;
+                ++m_binStart[bin + 1];
+            }
+
+            // Prefix sum into bin offsets
+            for(int b = 0; b < numBins; ++b)
+                m_binStart[b + 1] += m_binStart[b];
+
+            // Scatter atom indices into their bin slots
+            m_cursor.assign(m_binStart.begin(), m_binStart.end() - 1);
+            m_atoms.resize(numAtoms);
+            for(int i = 0; i < numAtoms; ++i)
+                m_atoms[m_cursor[m_atomBin[i]]++] = i;
+        }
+
+        int cellsPerDim() const { return m_cellsPerDim; }
+        int numCells() const { return m_cellsPerDim * m_cellsPerDim * m_cellsPerDim; }
+        double cellSize() const { return m_boxSize / m_cellsPerDim; }
+
+        int cellIndex(int cx, int cy, int cz) const
+        {
+            return (cz * m_cellsPerDim + cy) * m_cellsPerDim + cx;
+        }
+
+        int cellCoord(double x) const
+        {
+            // Clamp so that atoms sitting exactly on the upper face still land in the last cell
+            return std::clamp(int(std::floor((x + 0.5 * m_boxSize) * m_invCellSize)), 0, m_cellsPerDim - 1);
+        }
+
+        int cellOf(const math::Vec3d& p) const
+        {
+            return cellIndex(cellCoord(p.x()), cellCoord(p.y()), cellCoord(p.z()));
+        }
+
+        // Atoms in cell c are atomIndices()[cellBegin(c)..cellEnd(c)), by increasing type
+        int cellBegin(int c) const { return m_binStart[c * m_numTypes]; }
+        int cellEnd(int c) const { return m_binStart[(c + 1) * m_numTypes]; }
+        const int* atomIndices() const { return m_atoms.data(); }
+
+        // Visit every unordered pair of atoms in the same or adjacent cells exactly once.
+        // Uses a half stencil (the cell itself plus 13 forward neighbors) so op(i, j) never sees (j, i).
+        template<class PairOp>
+        void forEachPair(PairOp&& op) const
+        {
+            const int n = m_cellsPerDim;
+            for(int cz = 0; cz < n; ++cz)
+            for(int cy = 0; cy < n; ++cy)
+            for(int cx = 0; cx < n; ++cx)
+            {
+                const int c = cellIndex(cx, cy, cz);
+                const int begin = cellBegin(c);
+                const int end = cellEnd(c);
+
+                // Pairs within the cell
+                for(int a = begin; a < end; ++a)
+                    for(int b = a + 1; b < end; ++b)
+                        op(m_atoms[a], m_atoms[b]);
+
+                // Pairs against forward neighbors
+                for(auto& offset : HalfStencil)
+                {
+                    if(n == 1)
+                        break;
+                    int nx = cx + offset[0];
+                    int ny = cy + offset[1];
+                    int nz = cz + offset[2];
+                    if(!wrapCoord(nx) || !wrapCoord(ny) || !wrapCoord(nz))
+                        continue;
+                    const int nc = cellIndex(nx, ny, nz);
+                    for(int a = begin; a < end; ++a)
+                        for(int b = cellBegin(nc); b < cellEnd(nc); ++b)
+                            op(m_atoms[a], m_atoms[b]);
+                }
+            }
+        }
+
+        // Visit every atom in the cell containing p and its (up to) 26 surrounding cells.
+        // With types, atoms are visited type by type across the whole neighborhood, so runs of the same type are as long as possible.
+        template<class AtomOp>
+        void forEachNearbyAtom(const math::Vec3d& p, AtomOp&& op) const
+        {
+            const int reach = m_cellsPerDim == 1 ? 0 : 1;
+            const int cx = cellCoord(p.x());
+            const int cy = cellCoord(p.y());
+            const int cz = cellCoord(p.z());
+            int bins[27];
+            int numNearby = 0;
+            for(int dz = -reach; dz <= reach; ++dz)
+            for(int dy = -reach; dy <= reach; ++dy)
+            for(int dx = -reach; dx <= reach; ++dx)
+            {
+                int nx = cx + dx;
+                int ny = cy + dy;
+                int nz = cz + dz;
+                if(wrapCoord(nx) && wrapCoord(ny) && wrapCoord(nz))
+                    bins[numNearby++] = cellIndex(nx, ny, nz) * m_numTypes;
+            }
+            for(int t = 0; t < m_numTypes; ++t)
+            {
+                for(int c = 0; c < numNearby; ++c)
+                {
+                    for(int b = m_binStart[bins[c] + t]; b < m_binStart[bins[c] + t + 1]; ++b)
+                        op(m_atoms[b]);
+                }
+            }
+        }
+
+    private:
+        // Bring a neighbor cell coordinate back into the grid.
+        // Returns false if it falls outside a non-periodic box.
+        bool wrapCoord(int& c) const
+        {
+            if(c >= 0 && c < m_cellsPerDim)
+                return true;
+            if(!m_periodic)
+                return false;
+            c = c < 0 ? c + m_cellsPerDim : c - m_cellsPerDim;
+            return true;
+        }
+
+        // Neighbor offsets strictly "after" the cell in lexicographic (z,y,x) order
+        static constexpr int HalfStencil[13][3] = {
+            { 1, 0, 0},
+            {-1, 1, 0}, { 0, 1, 0}, { 1, 1, 0},
+            {-1,-1, 1}, { 0,-1, 1}, { 1,-1, 1},
+            {-1, 0, 1}, { 0, 0, 1}, { 1, 0, 1},
+            {-1, 1, 1}, { 0, 1, 1}, { 1, 1, 1}
+        };
+
+        double m_boxSize = 1;
+        double m_invCellSize = 1;
+        bool m_periodic = false;
+        int m_cellsPerDim = 1;
+        int m_numTypes = 1;
+        std::vector<int> m_binStart; // numCells * numTypes + 1 offsets into m_atoms, by cell then type
+        std::vector<int> m_atoms; // Atom indices sorted by cell and type
+        std::vector<int> m_atomBin; // Bin of each atom
+        std::vector<int> m_cursor; // Scratch for the counting sort
+    };
+}
@@ -0,0 +1,133 @@
+// Molecular dynamics playground
+#include "checkpoint.h"
+#include "barostat.h"
+#include "thermostat.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MD_CHECKPOINT_MMAP
+#endif
+
+namespace md
+{
+    namespace
+    {
+        // Every atom's type indexes the per type tables of the saved species
+        bool typesInRange(const CheckpointHeader& header, const AtomBuffer& atoms, const char* arena)
+        {
+            const int* types = atoms.arenaTypes(arena, header.numAtoms);
+            return std::all_of(types, types + header.numAtoms, [&](int t) { return t >= 0 && t < header.numTypes; });
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool CheckpointHeader::valid() const
+    {
+        const CheckpointHeader reference;
+        return std::memcmp(magic, reference.magic, sizeof(magic)) == 0 && version == CheckpointVersion
+            && headerBytes == CheckpointHeaderBytes && numAtoms >= 0 && nextId >= numAtoms && boxSize > 0 && numTypes > 0
+            && thermostat >= int32_t(ThermostatKind::None) && thermostat <= int32_t(ThermostatKind::Langevin)
+            && barostat >= int32_t(BarostatKind::None) && barostat <= int32_t(BarostatKind::MTK)
+            && thermostatStateSize >= 0 && thermostatStateSize <= MaxExtendedState
+            && barostatStateSize >= 0 && barostatStateSize <= MaxExtendedState;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void CheckpointWriter::write(const std::string& path, const CheckpointHeader& header, const AtomBuffer& atoms)
+    {
+        wait();
+        const size_t arenaBytes = atoms.layoutBytes(atoms.paddedSize());
+        m_staging.resize(CheckpointHeaderBytes + arenaBytes);
+        std::memset(m_staging.data(), 0, CheckpointHeaderBytes);
+        CheckpointHeader h = header;
+        h.arenaBytes = arenaBytes;
+        std::memcpy(m_staging.data(), &h, sizeof(h));
+        atoms.copyArena(m_staging.data() + CheckpointHeaderBytes);
+
+        m_thread = std::thread([this, path]() {
+            const std::string tempPath = path + ".tmp";
+            std::FILE* file = std::fopen(tempPath.c_str(), "wb");
+            bool ok = file && std::fwrite(m_staging.data(), 1, m_staging.size(), file) == m_staging.size();
+            if(file)
+                ok = std::fclose(file) == 0 && ok;
+            std::error_code error;
+            if(ok)
+                std::filesystem::rename(tempPath, path, error);
+            m_ok = ok && !error;
+        });
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool CheckpointWriter::wait()
+    {
+        if(m_thread.joinable())
+            m_thread.join();
+        return m_ok;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool readCheckpoint(const std::string& path, CheckpointHeader& header, AtomBuffer& atoms,
+        const std::function<bool(const CheckpointHeader&)>& accept)
+    {
+#ifdef MD_CHECKPOINT_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat info;
+        const bool readable = ::fstat(fd, &info) == 0 && size_t(info.st_size) >= CheckpointHeaderBytes
+            && ::pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header));
+        const size_t fileBytes = size_t(info.st_size);
+        if(!readable || !header.valid() || fileBytes != CheckpointHeaderBytes + header.arenaBytes
+            || header.arenaBytes != atoms.layoutBytes(AtomBuffer::padded(header.numAtoms)) || (accept && !accept(header)))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        // Private mapping: the simulation writes to its streams without touching the file
+        void* base = ::mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(base == MAP_FAILED)
+            return false;
+        if(!typesInRange(header, atoms, static_cast<char*>(base) + CheckpointHeaderBytes))
+        {
+            ::munmap(base, fileBytes);
+            return false;
+        }
+        atoms.adoptArena(static_cast<char*>(base) + CheckpointHeaderBytes, header.arenaBytes, header.numAtoms, header.nextId,
+            [base, fileBytes]() { ::munmap(base, fileBytes); });
+        return true;
+#else
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if(!file)
+            return false;
+        bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && header.valid()
+            && header.arenaBytes == atoms.layoutBytes(AtomBuffer::padded(header.numAtoms)) && (!accept || accept(header))
+            && std::fseek(file, long(CheckpointHeaderBytes), SEEK_SET) == 0;
+        char* arena = nullptr;
+        if(ok)
+        {
+            arena = static_cast<char*>(::operator new[](header.arenaBytes, std::align_val_t(StreamAlignment)));
+            ok = std::fread(arena, 1, header.arenaBytes, file) == header.arenaBytes && typesInRange(header, atoms, arena);
+        }
+        std::fclose(file);
+        if(!ok)
+        {
+            if(arena)
+                ::operator delete[](arena, std::align_val_t(StreamAlignment));
+            return false;
+        }
+        atoms.adoptArena(arena, header.arenaBytes, header.numAtoms, header.nextId,
+            [arena]() { ::operator delete[](arena, std::align_val_t(StreamAlignment)); });
+        return true;
+#endif
+    }
+}
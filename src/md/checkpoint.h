@@ -0,0 +1,84 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "atomBuffer.h"
+
+namespace md
+{
+    // Checkpoints store the atom streams exactly as they are laid out in memory, so they can be mapped back without parsing
+    static_assert(std::endian::native == std::endian::little, "Checkpoints are little-endian");
+
+    static constexpr uint32_t CheckpointVersion = 5;
+    // The header is padded to a page, so the atom arena behind it is page aligned and can be mapped in place
+    static constexpr size_t CheckpointHeaderBytes = 4096;
+    static constexpr int MaxExtendedState = 32;
+
+    // Fixed size header at the start of a checkpoint file, followed by the atom arena (see AtomBuffer::copyArena)
+    struct CheckpointHeader
+    {
+        char magic[8] = { 'A', 'R', 'G', 'O', 'N', 'C', 'K', 'P' };
+        uint32_t version = CheckpointVersion;
+        uint32_t headerBytes = CheckpointHeaderBytes;
+        uint64_t arenaBytes = 0;
+        int32_t numAtoms = 0;
+        int32_t nextId = 0;
+        uint64_t stepCount = 0;
+        double time = 0;
+        double boxSize = 0;
+        double boxScale = 1; // Pending barostat rescaling
+        double kineticEnergy = 0;
+        double potentialEnergy = 0;
+        double virial = 0;
+        double cutoff = 0; // Pair cutoff of the saved accelerations
+        int32_t seed = 0; // Key of the counter-based random streams
+        int32_t numTypes = 1; // Species count, bounding every entry of the type stream
+        int32_t stepsSinceReorder = 0;
+        int32_t thermostat = 0; // ThermostatKind
+        int32_t barostat = 0; // BarostatKind
+        int32_t thermostatStateSize = 0;
+        int32_t barostatStateSize = 0;
+        double thermostatState[MaxExtendedState] = {};
+        double barostatState[MaxExtendedState] = {};
+
+        bool valid() const;
+    };
+    static_assert(sizeof(CheckpointHeader) <= CheckpointHeaderBytes);
+
+    // Writes checkpoints on a background thread. The atom streams are first copied into a staging buffer,
+    // so the simulation can keep stepping while the file is written.
+    // Files are written under a temporary name and renamed when complete, so a crash never leaves a truncated checkpoint.
+    class CheckpointWriter
+    {
+    public:
+        CheckpointWriter() = default;
+        ~CheckpointWriter() { wait(); }
+
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+        // Snapshot header and atoms, and start writing them to path. Waits for the previous write first.
+        void write(const std::string& path, const CheckpointHeader& header, const AtomBuffer& atoms);
+
+        // Wait for the pending write, if any. False if the last write failed.
+        bool wait();
+
+    private:
+        std::thread m_thread;
+        std::vector<char> m_staging;
+        bool m_ok = true; // Set by the writer thread, read after joining it
+    };
+
+    // Read a checkpoint and hand its atom arena over to atoms.
+    // Where supported, the file is memory mapped copy-on-write: loading only touches the header and the type stream,
+    // other atom pages are read on first use. accept, if set, vets the header before atoms is touched.
+    // False, with atoms unchanged, if the file can't be read, isn't a valid checkpoint, has types beyond its species count,
+    // or isn't accepted.
+    bool readCheckpoint(const std::string& path, CheckpointHeader& header, AtomBuffer& atoms,
+        const std::function<bool(const CheckpointHeader&)>& accept = {});
+}
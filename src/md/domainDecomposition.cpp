@@ -0,0 +1,622 @@
+// Molecular dynamics playground
+#include "domainDecomposition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <thread>
+#include "cellList.h"
+#include "spscRing.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace md
+{
+    namespace
+    {
+        constexpr int RingCapacity = 1024; // Records per ring. Longer batches stream through while both sides make progress.
+
+        // Most cubic split of n domains, with the most domains along z so that consecutive indices form slabs
+        std::array<int, 3> domainGrid(int n)
+        {
+            std::array<int, 3> best = { 1, 1, n };
+            for(int a = 1; a <= n; ++a)
+            {
+                for(int b = 1; a * b <= n; ++b)
+                {
+                    if(n % (a * b))
+                        continue;
+                    const int c = n / (a * b);
+                    if(a + b + c < best[0] + best[1] + best[2])
+                        best = { a, b, c };
+                }
+            }
+            return best;
+        }
+
+        // CPUs of each NUMA node, or of a single node when the topology isn't known
+        std::vector<std::vector<int>> numaNodes()
+        {
+            std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+            for(int node = 0;; ++node)
+            {
+                char path[64];
+                std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+                FILE* file = std::fopen(path, "r");
+                if(!file)
+                    break;
+                // Comma separated ranges, such as 0-15,32-47
+                std::vector<int> cpus;
+                int first, last;
+                while(std::fscanf(file, "%d", &first) == 1)
+                {
+                    last = first;
+                    if(std::fscanf(file, "-%d", &last) != 1)
+                        last = first;
+                    for(int cpu = first; cpu <= last; ++cpu)
+                        cpus.push_back(cpu);
+                    if(std::fgetc(file) != ',')
+                        break;
+                }
+                std::fclose(file);
+                if(!cpus.empty())
+                    nodes.push_back(std::move(cpus));
+            }
+#endif
+            if(nodes.empty())
+            {
+                nodes.emplace_back(std::max(1, int(std::thread::hardware_concurrency())));
+                for(int cpu = 0; cpu < int(nodes[0].size()); ++cpu)
+                    nodes[0][cpu] = cpu;
+            }
+            return nodes;
+        }
+
+        // CPU of each domain. Domains fill one node before the next, with one CPU each, wrapping around when a node
+        // has fewer CPUs than domains. Only CPUs the calling thread may run on are used, as restricted by cpusets,
+        // containers or taskset.
+        std::vector<int> domainCpus(int numDomains)
+        {
+            std::vector<std::vector<int>> nodes = numaNodes();
+#ifdef __linux__
+            cpu_set_t allowed;
+            if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+            {
+                std::vector<int> allowedCpus;
+                for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                {
+                    if(CPU_ISSET(cpu, &allowed))
+                        allowedCpus.push_back(cpu);
+                }
+                for(auto& cpus : nodes)
+                    std::erase_if(cpus, [&](int cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed); });
+                std::erase_if(nodes, [](const std::vector<int>& cpus) { return cpus.empty(); });
+                if(nodes.empty() && !allowedCpus.empty())
+                    nodes.push_back(std::move(allowedCpus));
+            }
+#endif
+            std::vector<int> cpus(numDomains);
+            const int numNodes = int(nodes.size());
+            for(int domain = 0; domain < numDomains; ++domain)
+            {
+                const int node = int(int64_t(domain) * numNodes / numDomains);
+                int first = domain;
+                while(first > 0 && int(int64_t(first - 1) * numNodes / numDomains) == node)
+                    --first;
+                cpus[domain] = nodes[node][(domain - first) % nodes[node].size()];
+            }
+            return cpus;
+        }
+    }
+
+    // Atom moved between domains. Migrations only fill in index, and the first record of every batch
+    // is a header whose index is the number of records that follow.
+    struct DomainDecomposition::Record
+    {
+        double x;
+        double y;
+        double z;
+        int index;
+        int type;
+    };
+
+    struct DomainDecomposition::Domain
+    {
+        ~Domain() { releaseArena(); }
+
+        void releaseArena()
+        {
+            if(arena)
+                ::operator delete(arena, std::align_val_t(StreamAlignment));
+            arena = nullptr;
+        }
+
+        // Per neighbor, in increasing domain order
+        std::vector<int> neighbors;
+        std::vector<SpscRing<Record>*> incoming; // In this domain's arena
+        std::vector<SpscRing<Record>*> outgoing; // In the neighbor's arena
+        std::vector<std::vector<Record>> outbox;
+        std::vector<std::vector<Record>> inbox;
+        std::vector<int> sent; // Records sent of each outbox, -1 before its header
+        std::vector<int> expected; // Size of each incoming batch, -1 until its header arrives
+        std::vector<int> received;
+        std::vector<std::vector<int>> sendLists; // Owned atoms sent as ghosts, by local index
+        std::vector<int> ghostBegin; // First local slot of the ghosts of each neighbor, and the end of the last one
+        char* arena = nullptr;
+
+        // Local atoms: owned ones first, then ghosts
+        std::vector<int> owned; // Global indices, increasing
+        std::vector<int> kept; // Scratch for migrations
+        std::vector<double> x;
+        std::vector<double> y;
+        std::vector<double> z;
+        std::vector<int> type;
+        std::vector<double> ax;
+        std::vector<double> ay;
+        std::vector<double> az;
+        CellList cells;
+        VerletList list;
+
+        PairListSums sums;
+        bool rebuilt = false;
+        uint64_t migrations = 0;
+        bool pinned = false; // Worker thread pinned, or tried to
+        bool pinFailed = false; // Last attempt to pin the domain's thread failed
+
+        int numOwned() const { return int(owned.size()); }
+        Vec3Stream positions() { return { x.data(), y.data(), z.data() }; }
+    };
+
+    //----------------------------------------------------------------------------------------------
+    DomainDecomposition::DomainDecomposition(int numDomains, bool pinThreads)
+        : m_grid(domainGrid(std::max(1, numDomains)))
+        , m_pinThreads(pinThreads)
+        , m_barrier(std::max(1, numDomains))
+    {
+        numDomains = std::max(1, numDomains);
+        for(int d = 0; d < numDomains; ++d)
+            m_domains.push_back(std::make_unique<Domain>());
+        m_maxDisplacement2.resize(numDomains);
+        m_stray.resize(numDomains);
+        m_pool = std::make_unique<ThreadPool>(numDomains);
+        if(m_pinThreads)
+            m_cpus = domainCpus(numDomains);
+    }
+
+    DomainDecomposition::~DomainDecomposition() = default;
+
+    //----------------------------------------------------------------------------------------------
+    void DomainDecomposition::resetStats()
+    {
+        m_numRebuilds = 0;
+        m_numMigrations = 0;
+        m_ghostTotal = 0;
+        m_ownedTotal = 0;
+        m_entryTotal = 0;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    std::vector<std::vector<int>> DomainDecomposition::neighborSets(const PeriodicBox& box, double reach) const
+    {
+        const int n = numDomains();
+        std::vector<std::vector<int>> sets(n);
+        for(int d = 0; d < n; ++d)
+        {
+            for(int e = 0; e < n; ++e)
+            {
+                if(e == d)
+                    continue;
+                const auto cd = coordinates(d);
+                const auto ce = coordinates(e);
+                double d2 = 0;
+                for(int axis = 0; axis < 3; ++axis)
+                {
+                    const double width = box.size / m_grid[axis];
+                    const double gap = std::max(0.0, std::abs(box.minimumImage((cd[axis] - ce[axis]) * width)) - width);
+                    d2 += gap * gap;
+                }
+                if(d2 < reach * reach)
+                    sets[d].push_back(e);
+            }
+        }
+        return sets;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    std::array<int, 3> DomainDecomposition::coordinates(int domain) const
+    {
+        return { domain % m_grid[0], domain / m_grid[0] % m_grid[1], domain / (m_grid[0] * m_grid[1]) };
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double DomainDecomposition::distance2(const PeriodicBox& box, int domain, double x, double y, double z) const
+    {
+        const auto c = coordinates(domain);
+        const double p[3] = { x, y, z };
+        double d2 = 0;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            const double width = box.size / m_grid[axis];
+            const double center = (c[axis] + 0.5) * width - 0.5 * box.size;
+            const double gap = std::max(0.0, std::abs(box.minimumImage(p[axis] - center)) - 0.5 * width);
+            d2 += gap * gap;
+        }
+        return d2;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    int DomainDecomposition::domainOf(const PeriodicBox& box, double x, double y, double z) const
+    {
+        auto coord = [&](double p, int axis) {
+            return std::clamp(int(std::floor((p / box.size + 0.5) * m_grid[axis])), 0, m_grid[axis] - 1);
+        };
+        return (coord(z, 2) * m_grid[1] + coord(y, 1)) * m_grid[0] + coord(x, 0);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Allocate the incoming rings of a domain from its thread, so that they live on its node
+    void DomainDecomposition::connect(Domain& domain, int index)
+    {
+        domain.neighbors = m_neighborSets[index];
+        const int numNeighbors = int(domain.neighbors.size());
+        domain.releaseArena();
+        const size_t ringBytes = SpscRing<Record>::bytes(RingCapacity);
+        const size_t bytes = std::max<size_t>(1, ringBytes * numNeighbors);
+        domain.arena = static_cast<char*>(::operator new(bytes, std::align_val_t(StreamAlignment)));
+        std::memset(domain.arena, 0, bytes);
+        domain.incoming.resize(numNeighbors);
+        for(int s = 0; s < numNeighbors; ++s)
+            domain.incoming[s] = SpscRing<Record>::create(domain.arena + s * ringBytes, RingCapacity);
+        domain.outgoing.assign(numNeighbors, nullptr);
+        domain.outbox.resize(numNeighbors);
+        domain.inbox.resize(numNeighbors);
+        domain.sent.resize(numNeighbors);
+        domain.expected.resize(numNeighbors);
+        domain.received.resize(numNeighbors);
+        domain.sendLists.resize(numNeighbors);
+        domain.ghostBegin.assign(numNeighbors + 1, 0);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Every domain exchanges at the same time: pushing to the outgoing rings and draining the incoming ones
+    // in the same loop, so batches longer than a ring keep flowing and no pair of domains waits on each other.
+    void DomainDecomposition::exchange(Domain& domain)
+    {
+        const int numNeighbors = int(domain.neighbors.size());
+        std::fill(domain.sent.begin(), domain.sent.end(), -1);
+        std::fill(domain.expected.begin(), domain.expected.end(), -1);
+        std::fill(domain.received.begin(), domain.received.end(), 0);
+        bool busy = true;
+        while(busy)
+        {
+            busy = false;
+            bool progress = false;
+            for(int s = 0; s < numNeighbors; ++s)
+            {
+                const auto& outbox = domain.outbox[s];
+                const int size = int(outbox.size());
+                int& sent = domain.sent[s];
+                if(sent < 0)
+                {
+                    Record header = {};
+                    header.index = size;
+                    if(domain.outgoing[s]->push(&header, 1) == 1)
+                    {
+                        sent = 0;
+                        progress = true;
+                    }
+                }
+                if(sent >= 0 && sent < size)
+                {
+                    const int n = domain.outgoing[s]->push(outbox.data() + sent, size - sent);
+                    sent += n;
+                    progress |= n > 0;
+                }
+                busy |= sent < size;
+
+                int& expected = domain.expected[s];
+                int& received = domain.received[s];
+                if(expected < 0)
+                {
+                    Record header;
+                    if(domain.incoming[s]->pop(&header, 1) == 1)
+                    {
+                        expected = header.index;
+                        domain.inbox[s].resize(expected);
+                        progress = true;
+                    }
+                }
+                if(expected >= 0 && received < expected)
+                {
+                    const int n = domain.incoming[s]->pop(domain.inbox[s].data() + received, expected - received);
+                    received += n;
+                    progress |= n > 0;
+                }
+                busy |= expected < 0 || received < expected;
+            }
+            if(busy && !progress)
+                std::this_thread::yield();
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    int DomainDecomposition::numUnpinned() const
+    {
+        return int(std::count_if(m_domains.begin(), m_domains.end(), [](const auto& domain) { return domain->pinFailed; }));
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // Pin the calling thread to the CPU of the domain. False if the OS refused.
+    bool DomainDecomposition::pinCurrentThread(int domain) const
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(m_cpus[domain], &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        // Left to the OS scheduler
+        (void)domain;
+        return false;
+#endif
+    }
+
+    //----------------------------------------------------------------------------------------------
+    PairListSums DomainDecomposition::computeForces(const Vec3Stream& pos, const int* types, int numTypes, Vec3Stream& acc,
+        int numAtoms, const PeriodicBox& box, double cutoff, double skin, bool moved, const DomainForces& forces)
+    {
+        const double reach = cutoff + skin;
+        auto sets = neighborSets(box, reach);
+        const bool reconnect = !m_connected || sets != m_neighborSets;
+        if(reconnect)
+            m_neighborSets = std::move(sets);
+        m_connected = true;
+
+#ifdef __linux__
+        // Domain 0 runs on the calling thread, which is only pinned for the duration of the call. Otherwise the caller,
+        // and every thread it starts later, would stay confined to that one CPU.
+        cpu_set_t callerCpus;
+        const bool restoreCaller = m_pinThreads && pthread_getaffinity_np(pthread_self(), sizeof(callerCpus), &callerCpus) == 0;
+#endif
+        m_pool->run([&](int d) {
+            Domain& domain = *m_domains[d];
+            if(m_pinThreads && (d == 0 || !domain.pinned))
+            {
+                domain.pinFailed = !pinCurrentThread(d);
+                domain.pinned = true;
+            }
+            if(reconnect)
+            {
+                connect(domain, d);
+                m_barrier.arrive_and_wait();
+                for(int s = 0; s < int(domain.neighbors.size()); ++s)
+                {
+                    const Domain& neighbor = *m_domains[domain.neighbors[s]];
+                    const int slot = int(std::lower_bound(neighbor.neighbors.begin(), neighbor.neighbors.end(), d) - neighbor.neighbors.begin());
+                    domain.outgoing[s] = neighbor.incoming[slot];
+                }
+            }
+
+            // Owned atoms into local slots, from the shared arrays
+            auto gatherOwned = [&]() {
+                const int n = domain.numOwned();
+                const int size = std::max(n, int(domain.x.size()));
+                domain.x.resize(size);
+                domain.y.resize(size);
+                domain.z.resize(size);
+                domain.type.resize(size);
+                for(int k = 0; k < n; ++k)
+                {
+                    const int i = domain.owned[k];
+                    domain.x[k] = pos.x[i];
+                    domain.y[k] = pos.y[i];
+                    domain.z[k] = pos.z[i];
+                    domain.type[k] = types ? types[i] : 0;
+                }
+            };
+
+            bool reset = moved || reconnect;
+            bool rebuild = reset;
+            if(!reset)
+            {
+                gatherOwned();
+                double max2 = domain.list.isStale(box, cutoff, skin, false) ? std::numeric_limits<double>::infinity() : 0;
+                const double scale = domain.list.referenceScale(box.size);
+                for(int k = 0; k < domain.numOwned(); ++k)
+                    max2 = std::max(max2, domain.list.displacement2(k, domain.x[k], domain.y[k], domain.z[k], scale));
+                m_maxDisplacement2[d] = max2;
+                m_barrier.arrive_and_wait();
+                rebuild = domain.list.needsRebuild(*std::max_element(m_maxDisplacement2.begin(), m_maxDisplacement2.end()), box.size);
+            }
+
+            domain.rebuilt = rebuild;
+            domain.migrations = 0;
+            const int numNeighbors = int(domain.neighbors.size());
+            if(rebuild)
+            {
+                if(!reset)
+                {
+                    // Atoms that left the domain go to the neighbor they are in. One that went further means the
+                    // atoms moved outside of the integration, and every domain starts over.
+                    domain.kept.clear();
+                    for(auto& outbox : domain.outbox)
+                        outbox.clear();
+                    bool stray = false;
+                    for(int k = 0; k < domain.numOwned(); ++k)
+                    {
+                        const int home = domainOf(box, domain.x[k], domain.y[k], domain.z[k]);
+                        if(home == d)
+                        {
+                            domain.kept.push_back(domain.owned[k]);
+                            continue;
+                        }
+                        const auto it = std::lower_bound(domain.neighbors.begin(), domain.neighbors.end(), home);
+                        if(it == domain.neighbors.end() || *it != home)
+                        {
+                            stray = true;
+                            continue;
+                        }
+                        Record record = {};
+                        record.index = domain.owned[k];
+                        domain.outbox[it - domain.neighbors.begin()].push_back(record);
+                    }
+                    m_stray[d] = stray;
+                    m_barrier.arrive_and_wait();
+                    reset = std::find(m_stray.begin(), m_stray.end(), char(1)) != m_stray.end();
+                    if(!reset)
+                    {
+                        exchange(domain);
+                        domain.owned.swap(domain.kept);
+                        for(int s = 0; s < numNeighbors; ++s)
+                        {
+                            domain.migrations += domain.outbox[s].size();
+                            for(const Record& record : domain.inbox[s])
+                                domain.owned.push_back(record.index);
+                        }
+                        std::sort(domain.owned.begin(), domain.owned.end());
+                    }
+                }
+                if(reset)
+                {
+                    domain.owned.clear();
+                    for(int i = 0; i < numAtoms; ++i)
+                    {
+                        if(domainOf(box, pos.x[i], pos.y[i], pos.z[i]) == d)
+                            domain.owned.push_back(i);
+                    }
+                }
+                gatherOwned();
+
+                // Owned atoms within reach of each neighbor become its ghosts
+                const int numOwned = domain.numOwned();
+                for(int s = 0; s < numNeighbors; ++s)
+                {
+                    const int neighbor = domain.neighbors[s];
+                    auto& sendList = domain.sendLists[s];
+                    auto& outbox = domain.outbox[s];
+                    sendList.clear();
+                    outbox.clear();
+                    for(int k = 0; k < numOwned; ++k)
+                    {
+                        if(distance2(box, neighbor, domain.x[k], domain.y[k], domain.z[k]) < reach * reach)
+                        {
+                            sendList.push_back(k);
+                            outbox.push_back({ domain.x[k], domain.y[k], domain.z[k], domain.owned[k], domain.type[k] });
+                        }
+                    }
+                }
+                exchange(domain);
+                domain.ghostBegin[0] = numOwned;
+                for(int s = 0; s < numNeighbors; ++s)
+                    domain.ghostBegin[s + 1] = domain.ghostBegin[s] + int(domain.inbox[s].size());
+                const int numLocal = domain.ghostBegin[numNeighbors];
+                domain.x.resize(numLocal);
+                domain.y.resize(numLocal);
+                domain.z.resize(numLocal);
+                domain.type.resize(numLocal);
+                for(int s = 0; s < numNeighbors; ++s)
+                {
+                    int slot = domain.ghostBegin[s];
+                    for(const Record& record : domain.inbox[s])
+                    {
+                        domain.x[slot] = record.x;
+                        domain.y[slot] = record.y;
+                        domain.z[slot] = record.z;
+                        domain.type[slot] = record.type;
+                        ++slot;
+                    }
+                }
+
+                // Rows for the owned atoms only, over every local atom
+                const Vec3Stream local = domain.positions();
+                domain.cells.build(local, numLocal, box, reach, types ? domain.type.data() : nullptr, numTypes);
+                domain.list.build(domain.cells, local, numOwned, box, cutoff, skin, false);
+            }
+            else
+            {
+                // Same ghosts in the same order, new positions
+                for(int s = 0; s < numNeighbors; ++s)
+                {
+                    const auto& sendList = domain.sendLists[s];
+                    auto& outbox = domain.outbox[s];
+                    outbox.resize(sendList.size());
+                    for(size_t j = 0; j < sendList.size(); ++j)
+                    {
+                        const int k = sendList[j];
+                        outbox[j] = { domain.x[k], domain.y[k], domain.z[k], domain.owned[k], domain.type[k] };
+                    }
+                }
+                exchange(domain);
+                for(int s = 0; s < numNeighbors; ++s)
+                {
+                    int slot = domain.ghostBegin[s];
+                    for(const Record& record : domain.inbox[s])
+                    {
+                        domain.x[slot] = record.x;
+                        domain.y[slot] = record.y;
+                        domain.z[slot] = record.z;
+                        domain.type[slot] = record.type;
+                        ++slot;
+                    }
+                }
+            }
+
+            // Forces on the owned atoms, back into the shared arrays
+            const int numOwned = domain.numOwned();
+            domain.ax.assign(numOwned, 0.0);
+            domain.ay.assign(numOwned, 0.0);
+            domain.az.assign(numOwned, 0.0);
+            DomainAtoms atoms;
+            atoms.x = domain.x.data();
+            atoms.y = domain.y.data();
+            atoms.z = domain.z.data();
+            atoms.ax = domain.ax.data();
+            atoms.ay = domain.ay.data();
+            atoms.az = domain.az.data();
+            atoms.types = domain.type.data();
+            atoms.neighbors = &domain.list;
+            atoms.numOwned = numOwned;
+            domain.sums = forces(atoms);
+            for(int k = 0; k < numOwned; ++k)
+            {
+                const int i = domain.owned[k];
+                acc.x[i] = domain.ax[k];
+                acc.y[i] = domain.ay[k];
+                acc.z[i] = domain.az[k];
+            }
+        });
+#ifdef __linux__
+        if(restoreCaller)
+            pthread_setaffinity_np(pthread_self(), sizeof(callerCpus), &callerCpus);
+#endif
+
+        // Reduced in domain order. Full lists visit each pair twice.
+        PairListSums sums;
+        for(const auto& domain : m_domains)
+        {
+            sums.energy += domain->sums.energy;
+            sums.virial += domain->sums.virial;
+            m_numMigrations += domain->migrations;
+        }
+        sums.energy *= 0.5;
+        sums.virial *= 0.5;
+        if(m_domains[0]->rebuilt)
+        {
+            ++m_numRebuilds;
+            for(const auto& domain : m_domains)
+            {
+                m_ghostTotal += domain->ghostBegin.back() - domain->numOwned();
+                m_ownedTotal += domain->numOwned();
+                m_entryTotal += domain->list.offsets()[domain->numOwned()];
+            }
+        }
+        return sums;
+    }
+}
@@ -0,0 +1,117 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <array>
+#include <barrier>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "atomBuffer.h"
+#include "ljKernel.h"
+#include "periodicBox.h"
+#include "threadPool.h"
+#include "verletList.h"
+
+namespace md
+{
+    // Local storage of a domain, as seen by the force evaluation: the atoms it owns come first,
+    // followed by ghost copies of the atoms of other domains within the list radius.
+    struct DomainAtoms
+    {
+        const double* x;
+        const double* y;
+        const double* z;
+        double* ax; // Owned atoms only
+        double* ay;
+        double* az;
+        const int* types; // Of every local atom
+        const VerletList* neighbors; // Full list rows of the owned atoms, over every local atom
+        int numOwned;
+    };
+
+    // Pair forces on the owned atoms of one domain, into its accelerations. Returns the sums over full list rows.
+    using DomainForces = std::function<PairListSums(const DomainAtoms&)>;
+
+    // Spatial domain decomposition of the box, for machines with several memory nodes.
+    // The box is split into a grid of equal domains, each owned by one worker thread, optionally pinned to the CPUs
+    // of a NUMA node (consecutive domains, which are neighbors in space, fill one node before the next).
+    // A domain keeps the positions of its atoms and of the ghost atoms it needs in its own node's memory,
+    // and builds its own cell and Verlet lists over them.
+    //
+    // Workers only touch the shared atom arrays for the atoms they own. Everything else travels through
+    // lock-free single producer single consumer rings, one per ordered pair of neighboring domains,
+    // carved from an arena on the receiving domain's node, as it would between processes:
+    // - when the lists are rebuilt, atoms that left a domain migrate to the domain they are in now,
+    //   then each domain sends the atoms within the list radius of each neighbor as that neighbor's ghosts;
+    // - on every other step, only the ghost positions are refreshed, in the same order.
+    // Rebuilds follow the Verlet list rule (see VerletList::needsRebuild) over the largest displacement in any domain.
+    //
+    // The owned atoms of a domain are those inside it at the last rebuild, sorted by index, so the results only
+    // depend on the positions at rebuild steps, not on how the atoms got there. They depend on the number of domains.
+    class DomainDecomposition
+    {
+    public:
+        // Grid of numDomains domains, as close to cubic as it factors
+        DomainDecomposition(int numDomains, bool pinThreads);
+        ~DomainDecomposition();
+
+        DomainDecomposition(const DomainDecomposition&) = delete;
+        DomainDecomposition& operator=(const DomainDecomposition&) = delete;
+
+        int numDomains() const { return int(m_domains.size()); }
+        bool pinsThreads() const { return m_pinThreads; }
+        // Domains along x, y and z. Domain indices run along x first.
+        const std::array<int, 3>& grid() const { return m_grid; }
+
+        // Accelerations of atoms [0, numAtoms) into acc, from forces evaluated by every domain, and the total energy
+        // and virial over full lists (halved). With moved, atoms were moved, added or reordered outside of the
+        // integration since the last call, and ownership is redistributed from scratch.
+        PairListSums computeForces(const Vec3Stream& pos, const int* types, int numTypes, Vec3Stream& acc, int numAtoms,
+            const PeriodicBox& box, double cutoff, double skin, bool moved, const DomainForces& forces);
+
+        // Tuning statistics
+        uint64_t numRebuilds() const { return m_numRebuilds; }
+        // Atoms that changed domain through the rings, over all rebuilds
+        uint64_t numMigrations() const { return m_numMigrations; }
+        // Ghost atoms per owned atom, averaged over rebuilds
+        double ghostRatio() const { return m_ownedTotal ? double(m_ghostTotal) / double(m_ownedTotal) : 0; }
+        // Full list entries per owned atom, averaged over rebuilds. Each pair appears in the lists of both of its atoms.
+        double averageListLength() const { return m_ownedTotal ? double(m_entryTotal) / double(m_ownedTotal) : 0; }
+        void resetStats();
+        // Domain threads that couldn't be pinned, with pinThreads
+        int numUnpinned() const;
+
+    private:
+        struct Domain;
+        struct Record;
+
+        // Domains whose region is within reach of each domain's region, excluding itself
+        std::vector<std::vector<int>> neighborSets(const PeriodicBox& box, double reach) const;
+        std::array<int, 3> coordinates(int domain) const;
+        // Squared distance from a point to the region of a domain
+        double distance2(const PeriodicBox& box, int domain, double x, double y, double z) const;
+        int domainOf(const PeriodicBox& box, double x, double y, double z) const;
+        void connect(Domain& domain, int index);
+        // Send each domain's outbox to every neighbor and fill its inboxes, neighbor by neighbor
+        void exchange(Domain& domain);
+        bool pinCurrentThread(int domain) const;
+
+        std::array<int, 3> m_grid;
+        bool m_pinThreads = false;
+        std::vector<int> m_cpus; // CPU of each domain, with pinThreads
+        std::vector<std::unique_ptr<Domain>> m_domains;
+        std::vector<std::vector<int>> m_neighborSets;
+        bool m_connected = false;
+        std::unique_ptr<ThreadPool> m_pool;
+        std::barrier<> m_barrier;
+        std::vector<double> m_maxDisplacement2; // Per domain, reduced by every domain after a barrier
+        std::vector<char> m_stray; // Per domain: an atom moved beyond the neighbors
+
+        uint64_t m_numRebuilds = 0;
+        uint64_t m_numMigrations = 0;
+        uint64_t m_ghostTotal = 0;
+        uint64_t m_ownedTotal = 0;
+        uint64_t m_entryTotal = 0;
+    };
+}
@@ -0,0 +1,128 @@
+// Molecular dynamics playground
+#include "ljKernel.h"
+#include "ljKernelImpl.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace md
+{
+    // Implemented in the per instruction set translation units
+    PairListKernelSet<double> pairListKernelsSse(double);
+    PairListKernelSet<float> pairListKernelsSse(float);
+    PairListKernelSet<double, float> pairListKernelsSse(double, float);
+    PairListKernelSet<double> pairListKernelsAvx2(double);
+    PairListKernelSet<float> pairListKernelsAvx2(float);
+    PairListKernelSet<double, float> pairListKernelsAvx2(double, float);
+    PairListKernelSet<double> pairListKernelsAvx512(double);
+    PairListKernelSet<float> pairListKernelsAvx512(float);
+    PairListKernelSet<double, float> pairListKernelsAvx512(double, float);
+
+    //----------------------------------------------------------------------------------------------
+    const char* simdLevelName(SimdLevel level)
+    {
+        switch(level)
+        {
+            case SimdLevel::SSE: return "SSE4.1";
+            case SimdLevel::AVX2: return "AVX2";
+            case SimdLevel::AVX512: return "AVX-512";
+            default: return "Scalar";
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    const char* pairPrecisionName(PairPrecision precision)
+    {
+        switch(precision)
+        {
+            case PairPrecision::Single: return "float";
+            case PairPrecision::Mixed: return "mixed";
+            default: return "double";
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool parsePairPrecision(const std::string& name, PairPrecision& precision)
+    {
+        if(name == "double") precision = PairPrecision::Double;
+        else if(name == "float") precision = PairPrecision::Single;
+        else if(name == "mixed") precision = PairPrecision::Mixed;
+        else return false;
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    SimdLevel detectSimdLevel()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuid(info, 1);
+        const bool sse41 = info[2] & (1 << 19);
+        const bool fma = info[2] & (1 << 12);
+        const bool osxsave = info[2] & (1 << 27);
+        const bool avx = info[2] & (1 << 28);
+        bool avx2 = false;
+        bool avx512 = false;
+        if(maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = info[1] & (1 << 5);
+            avx512 = info[1] & (1 << 16);
+        }
+        // The OS must save the wider register state on context switches
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        const bool osAvx = (xcr0 & 0x6) == 0x6;
+        const bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+
+        if(avx512 && osAvx512)
+            return SimdLevel::AVX512;
+        if(avx && avx2 && fma && osAvx)
+            return SimdLevel::AVX2;
+        if(sse41)
+            return SimdLevel::SSE;
+        return SimdLevel::Scalar;
+#else
+        // Also checks OS support for the extended register state
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f"))
+            return SimdLevel::AVX512;
+        if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return SimdLevel::AVX2;
+        if(__builtin_cpu_supports("sse4.1"))
+            return SimdLevel::SSE;
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    //----------------------------------------------------------------------------------------------
+    // The precision tags select the overload of each instruction set
+    template<class T, class C, class... Precision>
+    PairListKernelSet<T, C> selectKernels(SimdLevel level, Precision... precision)
+    {
+        switch(level)
+        {
+            case SimdLevel::SSE: return pairListKernelsSse(precision...);
+            case SimdLevel::AVX2: return pairListKernelsAvx2(precision...);
+            case SimdLevel::AVX512: return pairListKernelsAvx512(precision...);
+            default: return makePairListKernels<ScalarPack<C>, ScalarPack<T>>();
+        }
+    }
+
+    PairListKernelSet<double> pairListKernels(SimdLevel level, double)
+    {
+        return selectKernels<double, double>(level, double());
+    }
+
+    PairListKernelSet<float> pairListKernels(SimdLevel level, float)
+    {
+        return selectKernels<float, float>(level, float());
+    }
+
+    PairListKernelSet<double, float> pairListKernels(SimdLevel level, double, float)
+    {
+        return selectKernels<double, float>(level, double(), float());
+    }
+}
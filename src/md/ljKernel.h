@@ -0,0 +1,136 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <cmath>
+#include <string>
+
+namespace md
+{
+    // Instruction sets with a dedicated pair kernel, in increasing order of width
+    enum class SimdLevel : int
+    {
+        Scalar,
+        SSE, // SSE4.1, 2 doubles / 4 floats per lane group
+        AVX2, // AVX2 + FMA, 4 doubles / 8 floats
+        AVX512 // AVX-512F, 8 doubles / 16 floats
+    };
+
+    const char* simdLevelName(SimdLevel level);
+
+    // Widest instruction set supported by both the CPU and the OS
+    SimdLevel detectSimdLevel();
+
+    // Precision of the Verlet list force evaluation
+    enum class PairPrecision : int
+    {
+        Double,
+        Single, // Float positions, forces and pair evaluation, on working copies of the atoms
+        Mixed // Double positions, displacements and sums, float pair evaluation at twice the lanes
+    };
+
+    const char* pairPrecisionName(PairPrecision precision);
+    // Inverse of pairPrecisionName. False, leaving precision untouched, for an unknown name
+    bool parsePairPrecision(const std::string& name, PairPrecision& precision);
+
+    // Functional form of the pair interaction evaluated by a kernel
+    enum class PairForm : int
+    {
+        LennardJones,
+        ShiftedForce, // Lennard-Jones with the force shifted to vanish at the cutoff
+        Tabulated // Cubic splines of r^2, see PairTable
+    };
+
+    // Part of each pair force evaluated by a kernel, for multiple time step integration.
+    // Inside the switching region [switchStart, switchStart + 1/invSwitchWidth], the inner band takes a fraction
+    // S(r) = 1 - 3 R^2 + 2 R^3 of the force and energy, R being the normalized position in the region,
+    // and the outer band takes the rest. S is 1 below the region and 0 beyond it.
+    enum class PairBand : int
+    {
+        All,
+        Inner,
+        Outer
+    };
+
+    // Inputs of a pair force evaluation over a compressed neighbor list.
+    // Atom i interacts with neighbors[begins[i]..ends[i]).
+    // Pair coefficients are indexed by types[i] * numTypes + types[j] (see PairCoefficients), or by 0 for untyped kernels.
+    // Positions and forces are of type T, pair coefficients and the pair evaluation of type C.
+    template<class T, class C = T>
+    struct PairListArgs
+    {
+        const T* x;
+        const T* y;
+        const T* z;
+        T* ax;
+        T* ay;
+        T* az;
+        const int* begins;
+        const int* ends;
+        const int* neighbors;
+        int iBegin; // Range of atoms i to evaluate
+        int iEnd;
+        T boxSize;
+        T imageScale; // 1/boxSize for periodic boxes, 0 otherwise (see PeriodicBox)
+        const int* types = nullptr;
+        int numTypes = 1;
+        const C* c12; // Lennard-Jones U(r) = c12 / r^12 - c6 / r^6
+        const C* c6;
+        const C* cutoff2;
+        const C* forceShift; // Magnitude of the force at the cutoff, subtracted by the shifted-force potential
+        const C* energyShift; // Subtracted from each pair energy so it vanishes at the cutoff: U(rc), plus rc F(rc) with shifted force
+        C switchStart = 0; // Switching region of the inner and outer bands, see PairBand
+        C invSwitchWidth = 0;
+        // Spline coefficients of the tabulated form, and the start of each pair's table in them (see PairTable)
+        const C* table = nullptr;
+        const int* tableOffsets = nullptr;
+        int tableIntervals = 0;
+        C tableStart = 0;
+        C tableInvSpacing = 0;
+    };
+
+    // Reductions over the evaluated pairs, summed in double precision.
+    // With full lists every pair is visited from both sides, so the caller halves them.
+    struct PairListSums
+    {
+        double energy = 0; // Potential energy
+        double virial = 0; // Sum of r . F, for the pressure
+    };
+
+    template<class T, class C = T>
+    using PairListKernel = PairListSums(*)(const PairListArgs<T, C>&);
+
+    // Kernel variants for one precision and instruction set
+    template<class T, class C = T>
+    struct PairListKernelSet
+    {
+        // Newton3: each pair is listed once and the reaction force is scattered into j (half lists).
+        // Otherwise only atom i is written to (full lists), which lets several threads share the arrays.
+        // Typed kernels look up coefficients by the types of each pair, the others use those of type 0.
+        PairListKernel<T, C> get(bool newton3, bool typed, PairForm form, PairBand band = PairBand::All) const
+        {
+            return kernels[newton3][typed][int(form)][int(band)];
+        }
+
+        PairListKernel<T, C> kernels[2][2][3][3]; // [newton3][typed][form][band]
+    };
+
+    // Kernels for the requested instruction set. The precision is selected by the types of the other arguments:
+    // (double, float) for mixed precision.
+    PairListKernelSet<double> pairListKernels(SimdLevel level, double);
+    PairListKernelSet<float> pairListKernels(SimdLevel level, float);
+    PairListKernelSet<double, float> pairListKernels(SimdLevel level, double, float);
+
+    // Lennard-Jones force magnitude F(r) = -dU/dr in reduced units (epsilon = sigma = 1)
+    inline double ljForce(double r)
+    {
+        const double inv_r6 = 1 / std::pow(r, 6);
+        return 24 * (2 * inv_r6 - 1) * inv_r6 / r;
+    }
+
+    // Lennard-Jones potential U(r) = 4 (1/r^12 - 1/r^6)
+    inline double ljEnergy(double r)
+    {
+        const double inv_r6 = 1 / std::pow(r, 6);
+        return 4 * (inv_r6 - 1) * inv_r6;
+    }
+}
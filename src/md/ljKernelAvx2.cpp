@@ -0,0 +1,23 @@
+// Molecular dynamics playground
+// Pair list kernels for AVX2 + FMA. This file is built with the matching target flags and
+// must only be called after checking CPU support (see detectSimdLevel).
+#include <math/vectorFloat.h>
+#include "ljKernelImpl.h"
+
+namespace md
+{
+    PairListKernelSet<double> pairListKernelsAvx2(double)
+    {
+        return makePairListKernels<math::double4>();
+    }
+
+    PairListKernelSet<float> pairListKernelsAvx2(float)
+    {
+        return makePairListKernels<math::float8>();
+    }
+
+    PairListKernelSet<double, float> pairListKernelsAvx2(double, float)
+    {
+        return makePairListKernels<math::float8, math::double4>();
+    }
+}
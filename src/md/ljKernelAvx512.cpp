@@ -0,0 +1,23 @@
+// Molecular dynamics playground
+// Pair list kernels for AVX-512F. This file is built with the matching target flags and
+// must only be called after checking CPU support (see detectSimdLevel).
+#include <math/vectorFloat.h>
+#include "ljKernelImpl.h"
+
+namespace md
+{
+    PairListKernelSet<double> pairListKernelsAvx512(double)
+    {
+        return makePairListKernels<math::double8>();
+    }
+
+    PairListKernelSet<float> pairListKernelsAvx512(float)
+    {
+        return makePairListKernels<math::float16>();
+    }
+
+    PairListKernelSet<double, float> pairListKernelsAvx512(double, float)
+    {
+        return makePairListKernels<math::float16, math::double8>();
+    }
+}
@@ -0,0 +1,317 @@
+// Molecular dynamics playground
+// Lennard-Jones pair list kernel, written once for any packed type.
+// Included only by the per instruction set translation units (ljKernel*.cpp), each built with its own target flags.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include "ljKernel.h"
+
+namespace md
+{
+    // Single lane "pack", used to build the scalar kernel from the same source
+    template<class T>
+    struct ScalarPack
+    {
+        using Scalar = T;
+        using Mask = bool;
+        static constexpr int Width = 1;
+
+        ScalarPack() = default;
+        explicit ScalarPack(T x) : m(x) {}
+
+        static ScalarPack load(const T* p) { return ScalarPack(*p); }
+        static ScalarPack gather(const T* base, const int* idx) { return ScalarPack(base[idx[0]]); }
+        static Mask firstLanes(int n) { return n > 0; }
+        void store(T* p) const { *p = m; }
+
+        ScalarPack operator+(ScalarPack b) const { return ScalarPack(m + b.m); }
+        ScalarPack operator-(ScalarPack b) const { return ScalarPack(m - b.m); }
+        ScalarPack operator*(ScalarPack b) const { return ScalarPack(m * b.m); }
+        ScalarPack operator/(ScalarPack b) const { return ScalarPack(m / b.m); }
+        Mask operator<(ScalarPack b) const { return m < b.m; }
+        ScalarPack mul_add(ScalarPack b, ScalarPack c) const { return ScalarPack(m * b.m + c.m); }
+        T hSum() const { return m; }
+
+        T m;
+    };
+
+    template<class T> ScalarPack<T> sqrt(ScalarPack<T> a) { return ScalarPack<T>(std::sqrt(a.m)); }
+    template<class T> ScalarPack<T> nearbyint(ScalarPack<T> a) { return ScalarPack<T>(std::nearbyint(a.m)); }
+    template<class T> ScalarPack<T> select(bool mask, ScalarPack<T> a) { return ScalarPack<T>(mask ? a.m : T(0)); }
+    template<class T> ScalarPack<T> min(ScalarPack<T> a, ScalarPack<T> b) { return ScalarPack<T>(std::min(a.m, b.m)); }
+    template<class T> ScalarPack<T> max(ScalarPack<T> a, ScalarPack<T> b) { return ScalarPack<T>(std::max(a.m, b.m)); }
+
+    // Conversions between a float pack and the double packs of the same lanes, for mixed precision kernels.
+    // Packed types provide their own (see math::narrow).
+    inline ScalarPack<float> narrow(const ScalarPack<double> (&d)[1]) { return ScalarPack<float>(float(d[0].m)); }
+    inline void widen(ScalarPack<float> f, ScalarPack<double> (&d)[1]) { d[0] = ScalarPack<double>(double(f.m)); }
+
+    // Pair coefficients of the types in each lane (see PairListArgs)
+    template<class Pack>
+    struct PairCoefficientPacks
+    {
+        Pack c12;
+        Pack c6;
+        Pack cutoff2;
+        Pack forceShift;
+        Pack energyShift;
+        int tableOffset = 0;
+
+        // The same pair in every lane
+        template<class Args>
+        void broadcast(const Args& args, int pair)
+        {
+            c12 = Pack(args.c12[pair]);
+            c6 = Pack(args.c6[pair]);
+            cutoff2 = Pack(args.cutoff2[pair]);
+            forceShift = Pack(args.forceShift[pair]);
+            energyShift = Pack(args.energyShift[pair]);
+            if(args.tableOffsets)
+                tableOffset = args.tableOffsets[pair];
+        }
+
+        // A pair per lane. Tabulated kernels look up table offsets themselves.
+        template<class Args>
+        void gather(const Args& args, const int* pairs)
+        {
+            c12 = Pack::gather(args.c12, pairs);
+            c6 = Pack::gather(args.c6, pairs);
+            cutoff2 = Pack::gather(args.cutoff2, pairs);
+            forceShift = Pack::gather(args.forceShift, pairs);
+            energyShift = Pack::gather(args.energyShift, pairs);
+        }
+    };
+
+    // Evaluate atoms [iBegin, iEnd) against their neighbors, Width neighbors at a time.
+    // The force on i, its energy and virial are accumulated in registers and reduced once per atom.
+    // Typed kernels look up the coefficients of each pair of types, the others use those of type 0 throughout.
+    // Positions, displacements and sums are in PositionPack, the pair evaluation in Pack. For mixed precision,
+    // r^2 of two double packs is narrowed into one float pack, and the force and energy are widened back.
+    template<class Pack, class PositionPack, bool Newton3, bool Typed, PairForm Form, PairBand Band>
+    PairListSums pairListForces(const PairListArgs<typename PositionPack::Scalar, typename Pack::Scalar>& args)
+    {
+        using T = typename PositionPack::Scalar;
+        using C = typename Pack::Scalar;
+        constexpr int W = Pack::Width;
+        constexpr int PW = PositionPack::Width;
+        constexpr int H = W / PW;
+        static_assert(H * PW == W, "a pack must hold a whole number of position packs");
+
+        const PositionPack boxSize(args.boxSize);
+        const PositionPack imageScale(args.imageScale);
+        const Pack one(C(1));
+        const Pack two(C(2));
+        const Pack three(C(3));
+        const Pack six(C(6));
+        const Pack twelve(C(12));
+        const Pack switchStart(args.switchStart);
+        const Pack invSwitchWidth(args.invSwitchWidth);
+        const Pack tableStart(args.tableStart);
+        const Pack tableInvSpacing(args.tableInvSpacing);
+        const Pack tableForceScale(-2 * args.tableInvSpacing);
+        const C* c0 = args.table;
+
+        alignas(64) int idx[W];
+        alignas(64) int pair[W];
+        alignas(64) T fx[W];
+        alignas(64) T fy[W];
+        alignas(64) T fz[W];
+        alignas(64) int segment[W];
+        alignas(64) C position[W];
+
+        // Lists come in runs of neighbors of the same type (see CellList), so most chunks hold a single pair of types,
+        // whose coefficients are broadcast and kept until the pair changes. Only chunks that straddle two types
+        // gather them lane by lane.
+        PairCoefficientPacks<Pack> coefficients;
+        coefficients.broadcast(args, 0);
+        int loaded = 0; // Pair broadcast in the coefficients, -1 after a gather
+
+        PairListSums sums;
+        for(int i = args.iBegin; i < args.iEnd; ++i)
+        {
+            const int row = Typed ? args.types[i] * args.numTypes : 0;
+            const PositionPack xi(args.x[i]);
+            const PositionPack yi(args.y[i]);
+            const PositionPack zi(args.z[i]);
+            PositionPack fxi(T(0));
+            PositionPack fyi(T(0));
+            PositionPack fzi(T(0));
+            PositionPack ei(T(0));
+            PositionPack viri(T(0));
+
+            const int end = args.ends[i];
+            for(int k = args.begins[i]; k < end; k += W)
+            {
+                // Tail lanes repeat a valid neighbor and are masked out
+                const int n = std::min(W, end - k);
+                for(int l = 0; l < W; ++l)
+                    idx[l] = args.neighbors[l < n ? k + l : k];
+                bool mixed = false;
+                if constexpr(Typed)
+                {
+                    for(int l = 0; l < W; ++l)
+                    {
+                        pair[l] = row + args.types[idx[l]];
+                        mixed |= pair[l] != pair[0];
+                    }
+                    if(mixed)
+                    {
+                        coefficients.gather(args, pair);
+                        loaded = -1;
+                    }
+                    else if(pair[0] != loaded)
+                    {
+                        coefficients.broadcast(args, pair[0]);
+                        loaded = pair[0];
+                    }
+                }
+                const Pack& c12 = coefficients.c12;
+                const Pack& c6 = coefficients.c6;
+                const Pack& forceShift = coefficients.forceShift;
+                const Pack& energyShift = coefficients.energyShift;
+
+                // Minimum image separations
+                PositionPack dx[H];
+                PositionPack dy[H];
+                PositionPack dz[H];
+                PositionPack r2h[H];
+                for(int h = 0; h < H; ++h)
+                {
+                    const int* lanes = idx + h * PW;
+                    dx[h] = PositionPack::gather(args.x, lanes) - xi;
+                    dy[h] = PositionPack::gather(args.y, lanes) - yi;
+                    dz[h] = PositionPack::gather(args.z, lanes) - zi;
+                    dx[h] = dx[h] - boxSize * nearbyint(dx[h] * imageScale);
+                    dy[h] = dy[h] - boxSize * nearbyint(dy[h] * imageScale);
+                    dz[h] = dz[h] - boxSize * nearbyint(dz[h] * imageScale);
+                    r2h[h] = dx[h].mul_add(dx[h], dy[h].mul_add(dy[h], dz[h] * dz[h]));
+                }
+
+                Pack r2;
+                if constexpr(std::is_same_v<Pack, PositionPack>)
+                    r2 = r2h[0];
+                else
+                    r2 = narrow(r2h);
+                const auto mask = (r2 < coefficients.cutoff2) & Pack::firstLanes(n);
+
+                Pack fr, e;
+                if constexpr(Form == PairForm::Tabulated)
+                {
+                    // Spline segment and position along it. Lanes beyond the table are clamped to it and masked out.
+                    ((r2 - tableStart) * tableInvSpacing).store(position);
+                    for(int l = 0; l < W; ++l)
+                    {
+                        const int k = std::clamp(int(position[l]), 0, args.tableIntervals - 1);
+                        position[l] -= C(k);
+                        segment[l] = 4 * k + (mixed ? args.tableOffsets[pair[l]] : coefficients.tableOffset);
+                    }
+                    const Pack u = Pack::load(position);
+                    const Pack a0 = Pack::gather(c0, segment);
+                    const Pack a1 = Pack::gather(c0 + 1, segment);
+                    const Pack a2 = Pack::gather(c0 + 2, segment);
+                    const Pack a3 = Pack::gather(c0 + 3, segment);
+                    // U = a0 + u (a1 + u (a2 + u a3)), F/r = -2 dU/ds
+                    e = u.mul_add(u.mul_add(u.mul_add(a3, a2), a1), a0);
+                    fr = tableForceScale * u.mul_add(u.mul_add(three * a3, two * a2), a1);
+                }
+                else
+                {
+                    // F(r)/r = (12 c12/r^12 - 6 c6/r^6) / r^2, U(r) = c12/r^12 - c6/r^6
+                    const Pack inv2 = one / r2;
+                    const Pack inv6 = inv2 * inv2 * inv2;
+                    const Pack a = c12 * inv6;
+                    fr = inv2 * inv6 * (twelve * a - six * c6);
+                    e = inv6 * (a - c6) - energyShift;
+                    if constexpr(Form == PairForm::ShiftedForce)
+                    {
+                        const Pack invr = sqrt(inv2);
+                        fr = fr - forceShift * invr;
+                        e = forceShift.mul_add(r2 * invr, e);
+                    }
+                }
+                if constexpr(Band != PairBand::All)
+                {
+                    // Outer weight 1 - S(r) = R^2 (3 - 2 R), with R clamped to [0, 1]
+                    const Pack zero(C(0));
+                    const Pack s = min(max((sqrt(r2) - switchStart) * invSwitchWidth, zero), one);
+                    Pack w = s * s * (three - two * s);
+                    if constexpr(Band == PairBand::Inner)
+                        w = one - w;
+                    fr = fr * w;
+                    e = e * w;
+                }
+                PositionPack frh[H];
+                PositionPack eh[H];
+                if constexpr(std::is_same_v<Pack, PositionPack>)
+                {
+                    frh[0] = select(mask, fr);
+                    eh[0] = select(mask, e);
+                }
+                else
+                {
+                    widen(select(mask, fr), frh);
+                    widen(select(mask, e), eh);
+                }
+                for(int h = 0; h < H; ++h)
+                {
+                    const PositionPack fxl = frh[h] * dx[h];
+                    const PositionPack fyl = frh[h] * dy[h];
+                    const PositionPack fzl = frh[h] * dz[h];
+                    fxi = fxi + fxl;
+                    fyi = fyi + fyl;
+                    fzi = fzi + fzl;
+                    ei = ei + eh[h];
+                    viri = frh[h].mul_add(r2h[h], viri);
+                    if constexpr(Newton3)
+                    {
+                        fxl.store(fx + h * PW);
+                        fyl.store(fy + h * PW);
+                        fzl.store(fz + h * PW);
+                    }
+                }
+
+                if constexpr(Newton3)
+                {
+                    for(int l = 0; l < n; ++l)
+                    {
+                        args.ax[idx[l]] += fx[l];
+                        args.ay[idx[l]] += fy[l];
+                        args.az[idx[l]] += fz[l];
+                    }
+                }
+            }
+
+            args.ax[i] -= fxi.hSum();
+            args.ay[i] -= fyi.hSum();
+            args.az[i] -= fzi.hSum();
+            sums.energy += double(ei.hSum());
+            sums.virial += double(viri.hSum());
+        }
+        return sums;
+    }
+
+    // Kernels evaluating pairs in Pack, with positions and sums in PositionPack
+    template<class Pack, class PositionPack = Pack>
+    PairListKernelSet<typename PositionPack::Scalar, typename Pack::Scalar> makePairListKernels()
+    {
+        PairListKernelSet<typename PositionPack::Scalar, typename Pack::Scalar> set;
+        auto fill = [&]<bool Newton3, bool Typed, PairForm Form>() {
+            auto& kernels = set.kernels[Newton3][Typed][int(Form)];
+            kernels[int(PairBand::All)] = &pairListForces<Pack, PositionPack, Newton3, Typed, Form, PairBand::All>;
+            kernels[int(PairBand::Inner)] = &pairListForces<Pack, PositionPack, Newton3, Typed, Form, PairBand::Inner>;
+            kernels[int(PairBand::Outer)] = &pairListForces<Pack, PositionPack, Newton3, Typed, Form, PairBand::Outer>;
+        };
+        auto fillForms = [&]<bool Newton3, bool Typed>() {
+            fill.template operator()<Newton3, Typed, PairForm::LennardJones>();
+            fill.template operator()<Newton3, Typed, PairForm::ShiftedForce>();
+            fill.template operator()<Newton3, Typed, PairForm::Tabulated>();
+        };
+        fillForms.template operator()<false, false>();
+        fillForms.template operator()<false, true>();
+        fillForms.template operator()<true, false>();
+        fillForms.template operator()<true, true>();
+        return set;
+    }
+}
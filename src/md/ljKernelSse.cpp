@@ -0,0 +1,23 @@
+// Molecular dynamics playground
+// Pair list kernels for SSE4.1. This file is built with the matching target flags and
+// must only be called after checking CPU support (see detectSimdLevel).
+#include <math/vectorFloat.h>
+#include "ljKernelImpl.h"
+
+namespace md
+{
+    PairListKernelSet<double> pairListKernelsSse(double)
+    {
+        return makePairListKernels<math::double2>();
+    }
+
+    PairListKernelSet<float> pairListKernelsSse(float)
+    {
+        return makePairListKernels<math::float4>();
+    }
+
+    PairListKernelSet<double, float> pairListKernelsSse(double, float)
+    {
+        return makePairListKernels<math::float4, math::double2>();
+    }
+}
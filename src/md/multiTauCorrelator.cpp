@@ -0,0 +1,123 @@
+// Molecular dynamics playground
+#include "multiTauCorrelator.h"
+
+#include <algorithm>
+
+namespace md
+{
+    //----------------------------------------------------------------------------------------------
+    void MultiTauCorrelator::reset(int numIds, int numLevels)
+    {
+        m_numIds = numIds;
+        m_numSamples = 0;
+        m_levels.assign(std::max(1, numLevels), Level());
+        m_sample.clear(); // Allocated by the first sample
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void MultiTauCorrelator::add(const Vec3Stream& values, const int* ids, int numAtoms)
+    {
+        // Ids without a live atom stay zero and add nothing to either kind of correlation
+        const size_t n = m_numIds;
+        if(m_sample.empty())
+            m_sample.assign(3 * n, 0);
+        for(int i = 0; i < numAtoms; ++i)
+        {
+            const size_t id = ids[i];
+            m_sample[id] = values.x[i];
+            m_sample[n + id] = values.y[i];
+            m_sample[2 * n + id] = values.z[i];
+        }
+        m_numAtoms = numAtoms;
+        ++m_numSamples;
+        push(0, m_sample.data());
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void MultiTauCorrelator::push(int l, const double* sample)
+    {
+        auto& level = m_levels[l];
+        const size_t n = m_numIds;
+        const size_t stride = 3 * n;
+        if(level.history.empty())
+        {
+            // Upper levels are only allocated once the run is long enough to reach them
+            level.history.resize(PointsPerLevel * stride);
+            level.block.assign(stride, 0);
+        }
+
+        level.newest = (level.newest + 1) % PointsPerLevel;
+        level.size = std::min(level.size + 1, PointsPerLevel);
+        double* newest = level.history.data() + level.newest * stride;
+        std::copy_n(sample, stride, newest);
+
+        // Lags below PointsPerLevel / BlockSize are covered by the level below at a finer resolution
+        const int firstLag = l == 0 ? 0 : PointsPerLevel / BlockSize;
+        for(int lag = firstLag; lag < level.size; ++lag)
+        {
+            const double* older = level.history.data() + ((level.newest - lag + PointsPerLevel) % PointsPerLevel) * stride;
+            double sum = 0;
+            if(m_kind == Kind::SquaredDisplacement)
+            {
+                for(size_t k = 0; k < stride; ++k)
+                {
+                    const double d = newest[k] - older[k];
+                    sum += d * d;
+                }
+            }
+            else
+            {
+                for(size_t k = 0; k < stride; ++k)
+                    sum += newest[k] * older[k];
+            }
+            level.sum[lag] += sum;
+            level.count[lag] += m_numAtoms;
+        }
+
+        // Compress every BlockSize samples into one sample of the next level
+        if(m_kind == Kind::Product)
+        {
+            for(size_t k = 0; k < stride; ++k)
+                level.block[k] += sample[k];
+        }
+        if(++level.blockCount < BlockSize)
+            return;
+        level.blockCount = 0;
+        if(l + 1 >= int(m_levels.size()))
+            return;
+        if(m_kind == Kind::SquaredDisplacement)
+        {
+            push(l + 1, sample);
+        }
+        else
+        {
+            m_compressed.resize(stride);
+            for(size_t k = 0; k < stride; ++k)
+                m_compressed[k] = level.block[k] * (1.0 / BlockSize);
+            std::fill(level.block.begin(), level.block.end(), 0);
+            push(l + 1, m_compressed.data());
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void MultiTauCorrelator::result(std::vector<double>& lags, std::vector<double>& values) const
+    {
+        lags.clear();
+        values.clear();
+        double spacing = 1;
+        for(size_t l = 0; l < m_levels.size(); ++l)
+        {
+            const auto& level = m_levels[l];
+            const int firstLag = l == 0 ? 0 : PointsPerLevel / BlockSize;
+            for(int lag = firstLag; lag < PointsPerLevel; ++lag)
+            {
+                if(level.count[lag])
+                {
+                    lags.push_back(lag * spacing);
+                    values.push_back(level.sum[lag] / double(level.count[lag]));
+                }
+            }
+            spacing *= BlockSize;
+        }
+    }
+}
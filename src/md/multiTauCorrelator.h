@@ -0,0 +1,68 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "atomBuffer.h"
+
+namespace md
+{
+    // Online time correlation of a per-atom vector quantity, averaged over atoms, with the multiple-tau scheme
+    // (Ramirez et al., J. Chem. Phys. 133, 154103, 2010).
+    // Level 0 keeps the last PointsPerLevel samples and correlates every new sample against them.
+    // Every BlockSize samples of a level are compressed into one sample of the next level, so level l covers lags
+    // up to PointsPerLevel * BlockSize^l samples: lag range grows exponentially, memory only linearly with the levels.
+    // Atoms are tracked by id, so reordering them in memory doesn't mix up their histories.
+    class MultiTauCorrelator
+    {
+    public:
+        static constexpr int PointsPerLevel = 16;
+        static constexpr int BlockSize = 2;
+
+        enum class Kind : int
+        {
+            // Mean squared displacement <|r(t + tau) - r(t)|^2>. Compression keeps one sample per block, so lags stay exact.
+            SquaredDisplacement,
+            // Autocorrelation <a(t) . a(t + tau)>. Compression averages each block.
+            Product
+        };
+
+        explicit MultiTauCorrelator(Kind kind) : m_kind(kind) {}
+
+        // Drop every sample, and track atom ids [0, numIds) over at most numLevels levels
+        void reset(int numIds, int numLevels);
+
+        // Add the values of numAtoms atoms at the next sample time
+        void add(const Vec3Stream& values, const int* ids, int numAtoms);
+
+        int numIds() const { return m_numIds; }
+        int numLevels() const { return int(m_levels.size()); }
+        uint64_t numSamples() const { return m_numSamples; }
+
+        // Correlation for each lag, in units of the sample interval, averaged over atoms. Lags without data are skipped.
+        void result(std::vector<double>& lags, std::vector<double>& values) const;
+
+    private:
+        struct Level
+        {
+            std::vector<double> history; // PointsPerLevel samples of x, y and z, each numIds long
+            std::vector<double> block; // Sum of the samples of the current block
+            int blockCount = 0;
+            int newest = -1; // History slot of the latest sample
+            int size = 0; // Filled history slots
+            double sum[PointsPerLevel] = {};
+            uint64_t count[PointsPerLevel] = {};
+        };
+
+        // Insert a sample (x, y and z, each numIds long) at level l, correlate it, and compress it upward
+        void push(int l, const double* sample);
+
+        Kind m_kind;
+        int m_numIds = 0;
+        int m_numAtoms = 0; // Atoms per sample, to average over
+        uint64_t m_numSamples = 0;
+        std::vector<Level> m_levels;
+        std::vector<double> m_sample; // Latest sample, in id order
+        std::vector<double> m_compressed;
+    };
+}
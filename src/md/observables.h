@@ -0,0 +1,79 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace md
+{
+    // Thermodynamic state at the end of one step. Everything here falls out of the force and velocity passes,
+    // so publishing it costs no extra pass over the atoms.
+    struct Observables
+    {
+        uint64_t step = 0;
+        double time = 0;
+        double kineticEnergy = 0;
+        double potentialEnergy = 0;
+        double extendedEnergy = 0; // Thermostat and barostat degrees of freedom
+        double virial = 0;
+        double temperature = 0;
+        double pressure = 0;
+        double volume = 0;
+
+        double totalEnergy() const { return kineticEnergy + potentialEnergy; }
+    };
+
+    // Lock-free single producer, single consumer queue of per step observables.
+    // The integrator pushes and never waits: when the reader falls behind, new samples are dropped and counted.
+    // A reader on another thread (UI, logger) pops at its own pace.
+    class ObservableRing
+    {
+    public:
+        // capacity is rounded up to a power of two
+        explicit ObservableRing(int capacity = 4096)
+        {
+            int size = 1;
+            while(size < capacity)
+                size *= 2;
+            m_mask = uint64_t(size - 1);
+            m_slots = std::make_unique<Observables[]>(size);
+        }
+
+        // Producer side
+        bool push(const Observables& o)
+        {
+            const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            if(tail - m_head.load(std::memory_order_acquire) > m_mask)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            m_slots[tail & m_mask] = o;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side
+        bool pop(Observables& o)
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            if(head == m_tail.load(std::memory_order_acquire))
+                return false;
+            o = m_slots[head & m_mask];
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        int capacity() const { return int(m_mask + 1); }
+        uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        // Indices grow without wrapping and each lives on its own cache line, so producer and consumer don't false share
+        alignas(64) std::atomic<uint64_t> m_tail = 0;
+        alignas(64) std::atomic<uint64_t> m_head = 0;
+        alignas(64) std::atomic<uint64_t> m_dropped = 0;
+        uint64_t m_mask = 0;
+        std::unique_ptr<Observables[]> m_slots;
+    };
+}
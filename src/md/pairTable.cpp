@@ -0,0 +1,120 @@
+// Molecular dynamics playground
+#include "pairTable.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace md
+{
+    //----------------------------------------------------------------------------------------------
+    PairPotential PairPotential::lennardJones(double epsilon, double sigma)
+    {
+        PairPotential p;
+        p.energy = [=](double r) {
+            const double sr6 = std::pow(sigma / r, 6);
+            return 4 * epsilon * sr6 * (sr6 - 1);
+        };
+        p.force = [=](double r) {
+            const double sr6 = std::pow(sigma / r, 6);
+            return 24 * epsilon * sr6 * (2 * sr6 - 1) / r;
+        };
+        return p;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    PairPotential PairPotential::buckingham(double a, double rho, double c)
+    {
+        PairPotential p;
+        p.energy = [=](double r) { return a * std::exp(-r / rho) - c / std::pow(r, 6); };
+        p.force = [=](double r) { return a / rho * std::exp(-r / rho) - 6 * c / std::pow(r, 7); };
+        return p;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    PairPotential PairPotential::morse(double depth, double alpha, double r0)
+    {
+        PairPotential p;
+        p.energy = [=](double r) {
+            const double x = 1 - std::exp(-alpha * (r - r0));
+            return depth * (x * x - 1);
+        };
+        p.force = [=](double r) {
+            const double e = std::exp(-alpha * (r - r0));
+            return -2 * depth * alpha * e * (1 - e);
+        };
+        return p;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    PairTable::PairTable(int numTypes, double rMin, double cutoff, int numIntervals)
+        : m_numTypes(numTypes)
+        , m_rMin(rMin)
+        , m_cutoff(cutoff)
+        , m_numIntervals(numIntervals)
+        , m_start(rMin * rMin)
+        , m_invSpacing(numIntervals / (cutoff * cutoff - rMin * rMin))
+    {
+        assert(numTypes > 0 && numIntervals > 0 && rMin < cutoff);
+        // One table per unordered pair, shared by both orders. Tables start zeroed: no interaction.
+        const int tableSize = 4 * numIntervals;
+        m_offsets.resize(numTypes * numTypes);
+        int numTables = 0;
+        for(int a = 0; a < numTypes; ++a)
+        {
+            for(int b = a; b < numTypes; ++b)
+                m_offsets[a * numTypes + b] = m_offsets[b * numTypes + a] = tableSize * numTables++;
+        }
+        m_coefficients.assign(size_t(tableSize) * numTables, 0.0);
+        m_coefficientsf.assign(m_coefficients.size(), 0.f);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void PairTable::set(int a, int b, const PairPotential& potential, bool shiftedForce)
+    {
+        const double rc = m_cutoff;
+        const double forceShift = shiftedForce ? potential.force(rc) : 0;
+        const double energyShift = potential.energy(rc);
+        const double spacing = 1 / m_invSpacing;
+
+        // Energy and its derivative dU/ds = -F / 2r at knot k
+        auto knot = [&](int k, double& u, double& dUds) {
+            const double r = std::sqrt(m_start + k * spacing);
+            u = potential.energy(r) - energyShift + (r - rc) * forceShift;
+            dUds = -(potential.force(r) - forceShift) / (2 * r);
+        };
+
+        // Hermite segments in u = (s - s_k) / spacing, so knot slopes are scaled by the spacing
+        double* c = m_coefficients.data() + offset(a, b);
+        double u0, d0;
+        knot(0, u0, d0);
+        for(int k = 0; k < m_numIntervals; ++k, c += 4)
+        {
+            double u1, d1;
+            knot(k + 1, u1, d1);
+            const double m0 = d0 * spacing;
+            const double m1 = d1 * spacing;
+            c[0] = u0;
+            c[1] = m0;
+            c[2] = 3 * (u1 - u0) - 2 * m0 - m1;
+            c[3] = 2 * (u0 - u1) + m0 + m1;
+            u0 = u1;
+            d0 = d1;
+        }
+        const int begin = offset(a, b);
+        const int end = begin + 4 * m_numIntervals;
+        std::transform(m_coefficients.begin() + begin, m_coefficients.begin() + end, m_coefficientsf.begin() + begin,
+            [](double x) { return float(x); });
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void PairTable::evaluate(int a, int b, double r2, double& forceOverR, double& energy) const
+    {
+        const double t = (r2 - m_start) * m_invSpacing;
+        const int k = std::clamp(int(t), 0, m_numIntervals - 1);
+        const double u = t - k;
+        const double* c = m_coefficients.data() + offset(a, b) + 4 * k;
+        energy = ((c[3] * u + c[2]) * u + c[1]) * u + c[0];
+        forceOverR = -2 * m_invSpacing * ((3 * c[3] * u + 2 * c[2]) * u + c[1]);
+    }
+}
@@ -0,0 +1,71 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace md
+{
+    // Pair interaction as a function of distance, in reduced units
+    struct PairPotential
+    {
+        std::function<double(double)> energy; // U(r)
+        std::function<double(double)> force; // F(r) = -dU/dr
+
+        static PairPotential lennardJones(double epsilon = 1, double sigma = 1);
+        // U(r) = A exp(-r / rho) - C / r^6
+        static PairPotential buckingham(double a, double rho, double c);
+        // U(r) = D ((1 - exp(-alpha (r - r0)))^2 - 1)
+        static PairPotential morse(double depth, double alpha, double r0);
+    };
+
+    // Pair potentials tabulated as cubic splines of s = r^2, one table per pair of atom types.
+    // Each table is a chain of cubic Hermite segments on a uniform grid of s, matching U and dU/ds at the knots.
+    // Kernels take F/r = -2 dU/ds from the same coefficients, so the force is the exact derivative of the tabulated
+    // energy, and any potential costs one segment lookup and two short polynomials per pair.
+    // Every table shares the same grid, so the lookup only differs by a per pair offset.
+    // Below rMin, the first segment is extrapolated.
+    class PairTable
+    {
+    public:
+        static constexpr int DefaultIntervals = 4096;
+
+        PairTable() = default;
+        PairTable(int numTypes, double rMin, double cutoff, int numIntervals = DefaultIntervals);
+
+        // Tabulate the interaction between types a and b, in both orders. The energy is shifted to vanish at the cutoff,
+        // and with shiftedForce the force too.
+        void set(int a, int b, const PairPotential& potential, bool shiftedForce = false);
+
+        int numTypes() const { return m_numTypes; }
+        double rMin() const { return m_rMin; }
+        double cutoff() const { return m_cutoff; }
+        int numIntervals() const { return m_numIntervals; }
+        // s of the first knot, and inverse knot spacing
+        double start() const { return m_start; }
+        double invSpacing() const { return m_invSpacing; }
+
+        // Index of the first coefficient of the table of types a and b. Segment k stores c0..c3 from 4 k,
+        // with U = c0 + u (c1 + u (c2 + u c3)) for u in [0, 1] along the segment.
+        int offset(int a, int b) const { return m_offsets[a * m_numTypes + b]; }
+        // Offsets of every type pair, row major
+        const int* offsets() const { return m_offsets.data(); }
+        const double* coefficients() const { return m_coefficients.data(); }
+        // Single precision copy, for the float kernels
+        const float* coefficientsf() const { return m_coefficientsf.data(); }
+
+        // Scalar evaluation of F(r)/r and U(r) at r2, picking segments the same way as the kernels
+        void evaluate(int a, int b, double r2, double& forceOverR, double& energy) const;
+
+    private:
+        int m_numTypes = 0;
+        double m_rMin = 0;
+        double m_cutoff = 0;
+        int m_numIntervals = 0;
+        double m_start = 0;
+        double m_invSpacing = 0;
+        std::vector<int> m_offsets;
+        std::vector<double> m_coefficients;
+        std::vector<float> m_coefficientsf;
+    };
+}
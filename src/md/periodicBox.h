@@ -0,0 +1,36 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <cmath>
+#include <math/vector.h>
+
+namespace md
+{
+    // Cubic simulation box centered at the origin, optionally with periodic boundary conditions.
+    struct PeriodicBox
+    {
+        PeriodicBox() = default;
+        PeriodicBox(double _size, bool _periodic)
+            : size(_size)
+            , periodic(_periodic)
+            , imageScale(_periodic ? 1 / _size : 0)
+        {}
+
+        // Wrap a separation vector to its nearest periodic image.
+        // Branch free: non-periodic boxes use imageScale = 0, so the rounding term vanishes
+        // and both cases cost the same per pair.
+        double minimumImage(double d) const
+        {
+            return d - size * std::nearbyint(d * imageScale);
+        }
+
+        math::Vec3d minimumImage(const math::Vec3d& d) const
+        {
+            return { minimumImage(d.x()), minimumImage(d.y()), minimumImage(d.z()) };
+        }
+
+        double size = 1;
+        bool periodic = false;
+        double imageScale = 0; // 1/size when periodic, 0 otherwise
+    };
+}
@@ -0,0 +1,58 @@
+// Molecular dynamics playground
+#include "radialDistribution.h"
+
+#include <numbers>
+
+namespace md
+{
+    //----------------------------------------------------------------------------------------------
+    void RadialDistribution::reset(int numBins, double rMax)
+    {
+        m_numBins = std::max(1, numBins);
+        m_rMax = rMax;
+        m_rMax2 = rMax * rMax;
+        m_invBinWidth = m_numBins / rMax;
+        m_radii.resize(m_numBins);
+        for(int b = 0; b < m_numBins; ++b)
+            m_radii[b] = binCenter(b);
+        for(auto& counts : m_threadCounts)
+            counts.assign(m_numBins, 0);
+        clear();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void RadialDistribution::clear()
+    {
+        for(auto& counts : m_threadCounts)
+            std::fill(counts.begin(), counts.end(), 0);
+        m_numSamples = 0;
+        m_pairDensity = 0;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void RadialDistribution::reserveThreads(int numThreads)
+    {
+        while(int(m_threadCounts.size()) < numThreads)
+            m_threadCounts.emplace_back(m_numBins, 0);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    const std::vector<double>& RadialDistribution::values()
+    {
+        // Expected pairs in the shell [r, r + dr) for an ideal gas: pair density times the shell volume
+        constexpr double FourThirdsPi = 4 * std::numbers::pi / 3;
+        const double binWidth = m_rMax / m_numBins;
+        m_values.assign(m_numBins, 0);
+        for(int b = 0; b < m_numBins; ++b)
+        {
+            uint64_t count = 0;
+            for(const auto& counts : m_threadCounts)
+                count += counts[b];
+            const double r0 = b * binWidth;
+            const double r1 = r0 + binWidth;
+            const double idealCount = m_pairDensity * FourThirdsPi * (r1 * r1 * r1 - r0 * r0 * r0);
+            m_values[b] = idealCount > 0 ? count / idealCount : 0;
+        }
+        return m_values;
+    }
+}
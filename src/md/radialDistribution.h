@@ -0,0 +1,60 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace md
+{
+    // Running histogram of pair separations up to rMax, normalized into the radial distribution function g(r).
+    // Each thread adds pairs to its own histogram, so sampling needs no synchronization.
+    // The histograms are only merged when g(r) is read.
+    class RadialDistribution
+    {
+    public:
+        // Set the binning and drop every sample taken so far
+        void reset(int numBins, double rMax);
+        // Drop every sample taken so far, keeping the binning
+        void clear();
+        // Make room for pairs from threads [0, numThreads)
+        void reserveThreads(int numThreads);
+
+        // Count one pair at squared separation r2, from the given thread. Pairs beyond rMax are ignored.
+        // Each pair must be counted once per sample.
+        void add(int thread, double r2)
+        {
+            if(r2 < m_rMax2)
+                ++m_threadCounts[thread][std::min(int(std::sqrt(r2) * m_invBinWidth), m_numBins - 1)];
+        }
+
+        // Close a sample over every pair of numAtoms atoms in the given volume
+        void endSample(int numAtoms, double volume)
+        {
+            ++m_numSamples;
+            m_pairDensity += 0.5 * numAtoms * (numAtoms - 1.0) / volume;
+        }
+
+        int numBins() const { return m_numBins; }
+        double rMax() const { return m_rMax; }
+        uint64_t numSamples() const { return m_numSamples; }
+        double binCenter(int bin) const { return (bin + 0.5) * m_rMax / m_numBins; }
+
+        // g(r) at the bin centers, averaged over every sample. Pair counts relative to an ideal gas of the same density.
+        const std::vector<double>& values();
+        // Bin centers, for plotting against values()
+        const std::vector<double>& radii() const { return m_radii; }
+
+    private:
+        int m_numBins = 0;
+        double m_rMax = 0;
+        double m_rMax2 = 0;
+        double m_invBinWidth = 0;
+        std::vector<std::vector<uint64_t>> m_threadCounts;
+        uint64_t m_numSamples = 0;
+        double m_pairDensity = 0; // Sum over samples of the number of pairs per unit volume
+        std::vector<double> m_radii;
+        std::vector<double> m_values;
+    };
+}
@@ -0,0 +1,76 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <cstdint>
+
+namespace md
+{
+    // Order in which atoms are laid out in memory by spatial reordering.
+    // Both keep atoms that are close in space close in memory. Hilbert has no long jumps between consecutive cells,
+    // at a slightly higher cost per key.
+    enum class SpaceFillingCurve : int
+    {
+        Morton,
+        Hilbert
+    };
+
+    // Spread the low 21 bits of x so there are two zero bits between each of them
+    inline uint64_t spreadBits3(uint32_t x)
+    {
+        uint64_t v = x & 0x1fffff;
+        v = (v | (v << 32)) & 0x1f00000000ffffull;
+        v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+        v = (v | (v << 8)) & 0x100f00f00f00f00full;
+        v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+        v = (v | (v << 2)) & 0x1249249249249249ull;
+        return v;
+    }
+
+    // Z-order key of a cell, with up to 21 bits per coordinate. x takes the most significant bit of each triple.
+    inline uint64_t mortonKey(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return (spreadBits3(x) << 2) | (spreadBits3(y) << 1) | spreadBits3(z);
+    }
+
+    // Hilbert curve index of a cell in a grid of 2^bits cells per side (bits <= 21).
+    // Uses Skilling's transform ("Programming the Hilbert curve", 2004) to the transposed index,
+    // whose bits interleave like a Morton key.
+    inline uint64_t hilbertKey(uint32_t x, uint32_t y, uint32_t z, int bits)
+    {
+        uint32_t X[3] = { x, y, z };
+        const uint32_t M = 1u << (bits - 1);
+
+        // Inverse undo
+        for(uint32_t Q = M; Q > 1; Q >>= 1)
+        {
+            const uint32_t P = Q - 1;
+            for(int i = 0; i < 3; ++i)
+            {
+                if(X[i] & Q)
+                {
+                    X[0] ^= P; // Invert
+                }
+                else
+                {
+                    const uint32_t t = (X[0] ^ X[i]) & P; // Exchange
+                    X[0] ^= t;
+                    X[i] ^= t;
+                }
+            }
+        }
+
+        // Gray encode
+        X[1] ^= X[0];
+        X[2] ^= X[1];
+        uint32_t t = 0;
+        for(uint32_t Q = M; Q > 1; Q >>= 1)
+        {
+            if(X[2] & Q)
+                t ^= Q - 1;
+        }
+        for(auto& c : X)
+            c ^= t;
+
+        return mortonKey(X[0], X[1], X[2]);
+    }
+}
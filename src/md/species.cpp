@@ -0,0 +1,78 @@
+// Molecular dynamics playground
+#include "species.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace md
+{
+    //----------------------------------------------------------------------------------------------
+    void PairCoefficients::build(const std::vector<Species>& species, const std::vector<PairOverride>& overrides, double cutoff,
+        bool shiftedForce, double tableCutoff)
+    {
+        const int n = std::max(1, int(species.size()));
+        const Species reference;
+        auto speciesOf = [&](int a) -> const Species& { return species.empty() ? reference : species[a]; };
+
+        m_numTypes = n;
+        auto& c = m_coefficients;
+        for(auto* v : { &c.c12, &c.c6, &c.cutoff2, &c.forceShift, &c.energyShift })
+            v->assign(n * n, 0.0);
+        auto setPair = [&](int a, int b, double epsilon, double sigma, double rc) {
+            rc = std::min(rc, cutoff);
+            if(tableCutoff > 0)
+                rc = std::min(rc, tableCutoff);
+            const double s6 = std::pow(sigma, 6);
+            const double c12 = 4 * epsilon * s6 * s6;
+            const double c6 = 4 * epsilon * s6;
+            const double inv6 = 1 / std::pow(rc, 6);
+            const double forceShift = shiftedForce && tableCutoff <= 0 ? (12 * c12 * inv6 - 6 * c6) * inv6 / rc : 0;
+            for(int k : { index(a, b), index(b, a) })
+            {
+                c.c12[k] = c12;
+                c.c6[k] = c6;
+                c.cutoff2[k] = rc * rc;
+                c.forceShift[k] = forceShift;
+                c.energyShift[k] = (c12 * inv6 - c6) * inv6 + rc * forceShift;
+            }
+        };
+        for(int a = 0; a < n; ++a)
+        {
+            for(int b = a; b < n; ++b)
+            {
+                const Species& sa = speciesOf(a);
+                const Species& sb = speciesOf(b);
+                setPair(a, b, std::sqrt(sa.epsilon * sb.epsilon), (sa.sigma + sb.sigma) / 2, cutoff);
+            }
+        }
+        for(const PairOverride& o : overrides)
+        {
+            assert(o.a >= 0 && o.a < n && o.b >= 0 && o.b < n);
+            setPair(o.a, o.b, o.epsilon, o.sigma, o.cutoff > 0 ? o.cutoff : cutoff);
+        }
+
+        auto& f = m_coefficientsf;
+        f.c12.assign(c.c12.begin(), c.c12.end());
+        f.c6.assign(c.c6.begin(), c.c6.end());
+        f.cutoff2.assign(c.cutoff2.begin(), c.cutoff2.end());
+        f.forceShift.assign(c.forceShift.begin(), c.forceShift.end());
+        f.energyShift.assign(c.energyShift.begin(), c.energyShift.end());
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void PairCoefficients::evaluate(int pair, double r2, double& forceOverR, double& energy) const
+    {
+        const auto& c = m_coefficients;
+        const double inv2 = 1 / r2;
+        const double inv6 = inv2 * inv2 * inv2;
+        const double a = c.c12[pair] * inv6;
+        forceOverR = (12 * a - 6 * c.c6[pair]) * inv6 * inv2;
+        energy = (a - c.c6[pair]) * inv6 - c.energyShift[pair];
+        if(c.forceShift[pair] != 0)
+        {
+            forceOverR -= c.forceShift[pair] * std::sqrt(inv2);
+            energy += c.forceShift[pair] * std::sqrt(r2);
+        }
+    }
+}
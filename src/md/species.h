@@ -0,0 +1,69 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace md
+{
+    // One kind of atom. Parameters are in the reduced units of the reference species (epsilon = sigma = m = 1).
+    struct Species
+    {
+        std::string name = "Ar";
+        double mass = 1;
+        double epsilon = 1; // Lennard-Jones well depth
+        double sigma = 1; // Lennard-Jones diameter
+        double fraction = 1; // Relative share of the atoms, when species are assigned at random
+    };
+
+    // Lennard-Jones parameters of a pair of species, in place of the mixing rules
+    struct PairOverride
+    {
+        int a = 0;
+        int b = 0;
+        double epsilon = 1;
+        double sigma = 1;
+        double cutoff = 0; // 0 keeps the global cutoff
+    };
+
+    // Coefficients of one precision, one entry per ordered pair of species
+    template<class T>
+    struct PairCoefficientsT
+    {
+        std::vector<T> c12;
+        std::vector<T> c6;
+        std::vector<T> cutoff2;
+        std::vector<T> forceShift; // F(rc) with the shifted-force potential, 0 otherwise
+        std::vector<T> energyShift; // U(rc) + rc F(rc), so pair energies vanish at the cutoff
+    };
+
+    // Lennard-Jones interactions of every pair of species, as a compact row major matrix indexed by
+    // typeA * numTypes() + typeB, which kernels look up per pair:
+    //   U(r) = c12 / r^12 - c6 / r^6 - energyShift + r forceShift
+    //   F(r) / r = (12 c12 / r^12 - 6 c6 / r^6) / r^2 - forceShift / r
+    // within the pair cutoff, which is at most the global one.
+    class PairCoefficients
+    {
+    public:
+        // Pairs without an override follow the Lorentz-Berthelot rules: sigma_ab = (sigma_a + sigma_b) / 2,
+        // epsilon_ab = sqrt(epsilon_a epsilon_b). No species stands for a single one of epsilon = sigma = 1.
+        // Cutoffs are capped by tableCutoff, for tabulated potentials. Shifts only apply to the built-in form.
+        void build(const std::vector<Species>& species, const std::vector<PairOverride>& overrides, double cutoff,
+            bool shiftedForce, double tableCutoff = 0);
+
+        int numTypes() const { return m_numTypes; }
+        int index(int a, int b) const { return a * m_numTypes + b; }
+
+        const PairCoefficientsT<double>& get(double) const { return m_coefficients; }
+        const PairCoefficientsT<float>& get(float) const { return m_coefficientsf; }
+        double cutoff2(int pair) const { return m_coefficients.cutoff2[pair]; }
+
+        // Scalar F(r)/r and U(r) of pair index at r2, inside the pair cutoff
+        void evaluate(int pair, double r2, double& forceOverR, double& energy) const;
+
+    private:
+        int m_numTypes = 0;
+        PairCoefficientsT<double> m_coefficients;
+        PairCoefficientsT<float> m_coefficientsf;
+    };
+}
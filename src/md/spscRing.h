@@ -0,0 +1,77 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace md
+{
+    // Lock-free single producer, single consumer ring of plain records, moved in batches.
+    // The ring lives in memory supplied by its owner, header first and slots right after it, and holds no pointers,
+    // so it can be placed in any shared arena: the consumer's NUMA node, or a mapping shared by several processes.
+    // Neither side ever waits: push and pop move as many records as fit or are available and return the count.
+    template<class T>
+    class SpscRing
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "records are copied as bytes");
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "indices must be usable across processes");
+
+    public:
+        // Bytes of a ring of capacity records, a power of two
+        static size_t bytes(int capacity) { return sizeof(SpscRing) + size_t(capacity) * sizeof(T); }
+
+        // Construct an empty ring in memory of at least bytes(capacity), aligned to a cache line
+        static SpscRing* create(void* memory, int capacity) { return new(memory) SpscRing(capacity); }
+
+        // Producer side
+        int push(const T* records, int count)
+        {
+            const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            const uint64_t head = m_head.load(std::memory_order_acquire);
+            const int n = std::min(count, int(m_capacity - (tail - head)));
+            copy(slots(), tail, records, n, [](T* slot, const T* record, int k) { std::memcpy(slot, record, k * sizeof(T)); });
+            m_tail.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // Consumer side
+        int pop(T* records, int maxCount)
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            const uint64_t tail = m_tail.load(std::memory_order_acquire);
+            const int n = std::min(maxCount, int(tail - head));
+            copy(slots(), head, records, n, [](T* slot, T* record, int k) { std::memcpy(record, slot, k * sizeof(T)); });
+            m_head.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        int capacity() const { return int(m_capacity); }
+
+    private:
+        explicit SpscRing(int capacity)
+            : m_capacity(uint64_t(capacity))
+        {}
+
+        T* slots() { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + sizeof(SpscRing)); }
+
+        // Move n records between consecutive slots from index and the records, in at most two pieces around the end
+        template<class Records, class Move>
+        void copy(T* slots, uint64_t index, Records* records, int n, Move&& move) const
+        {
+            const int first = int(index & (m_capacity - 1));
+            const int k = std::min(n, int(m_capacity) - first);
+            move(slots + first, records, k);
+            move(slots, records + k, n - k);
+        }
+
+        // Indices grow without wrapping and each lives on its own cache line, so producer and consumer don't false share
+        alignas(64) std::atomic<uint64_t> m_tail = 0;
+        alignas(64) std::atomic<uint64_t> m_head = 0;
+        alignas(64) uint64_t m_capacity = 0;
+    };
+}
@@ -0,0 +1,124 @@
+// Molecular dynamics playground
+#include "thermostat.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace md
+{
+    //----------------------------------------------------------------------------------------------
+    VelocityUpdate BerendsenThermostat::begin(const ThermostatParams& params, double kineticEnergy, int degreesOfFreedom, double h)
+    {
+        // lambda^2 = 1 + h/tau (T0/T - 1), bounded to keep the first steps from a cold or hot start stable
+        VelocityUpdate update;
+        const double temperature = 2 * kineticEnergy / std::max(1, degreesOfFreedom);
+        if(temperature > 0)
+        {
+            const double lambda2 = 1 + h / params.tau * (params.temperature / temperature - 1);
+            update.velocityScale = std::clamp(std::sqrt(std::max(lambda2, 0.0)), 0.8, 1.25);
+            update.forceScale = update.velocityScale;
+        }
+        return update;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double NoseHooverChainThermostat::mass(const ThermostatParams& params, int degreesOfFreedom, int i) const
+    {
+        const double q = params.temperature * params.tau * params.tau;
+        return i == 0 ? degreesOfFreedom * q : q;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    VelocityUpdate NoseHooverChainThermostat::begin(const ThermostatParams& params, double kineticEnergy, int degreesOfFreedom, double h)
+    {
+        const int m = std::max(1, params.chainLength);
+        if(int(m_velocity.size()) != m)
+        {
+            m_position.assign(m, 0);
+            m_velocity.assign(m, 0);
+        }
+
+        const double t0 = params.temperature;
+        const double dof = degreesOfFreedom;
+        auto force = [&](int i, double ke) {
+            if(i == 0)
+                return (2 * ke - dof * t0) / mass(params, degreesOfFreedom, 0);
+            const double prev = m_velocity[i - 1];
+            return (mass(params, degreesOfFreedom, i - 1) * prev * prev - t0) / mass(params, degreesOfFreedom, i);
+        };
+        // Half kick of chain element i over a step dt, scaled by the element above it
+        auto kick = [&](int i, double ke, double dt) {
+            if(i + 1 < m)
+                m_velocity[i] *= std::exp(-m_velocity[i + 1] * dt / 4);
+            m_velocity[i] += force(i, ke) * dt / 2;
+            if(i + 1 < m)
+                m_velocity[i] *= std::exp(-m_velocity[i + 1] * dt / 4);
+        };
+
+        // Chain velocities top to bottom, scale the particle velocities, then back up
+        double ke = kineticEnergy;
+        for(int i = m - 1; i >= 0; --i)
+            kick(i, ke, h);
+        const double scale = std::exp(-m_velocity[0] * h);
+        ke *= scale * scale;
+        for(int i = 0; i < m; ++i)
+            m_position[i] += m_velocity[i] * h;
+        for(int i = 0; i < m; ++i)
+            kick(i, ke, h);
+
+        VelocityUpdate update;
+        update.velocityScale = scale;
+        return update;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    double NoseHooverChainThermostat::energy(const ThermostatParams& params, int degreesOfFreedom) const
+    {
+        double e = 0;
+        for(size_t i = 0; i < m_velocity.size(); ++i)
+        {
+            e += 0.5 * mass(params, degreesOfFreedom, int(i)) * m_velocity[i] * m_velocity[i];
+            e += (i == 0 ? degreesOfFreedom : 1) * params.temperature * m_position[i];
+        }
+        return e;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    std::vector<double> NoseHooverChainThermostat::state() const
+    {
+        std::vector<double> state(m_position);
+        state.insert(state.end(), m_velocity.begin(), m_velocity.end());
+        return state;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void NoseHooverChainThermostat::setState(const std::vector<double>& state)
+    {
+        const size_t m = state.size() / 2;
+        m_position.assign(state.begin(), state.begin() + m);
+        m_velocity.assign(state.begin() + m, state.begin() + 2 * m);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    VelocityUpdate LangevinThermostat::begin(const ThermostatParams& params, double, int, double h)
+    {
+        const double c = std::exp(-params.friction * h);
+        VelocityUpdate update;
+        update.velocityScale = c;
+        update.forceScale = c;
+        update.noise = std::sqrt((1 - c * c) * params.temperature); // Unit mass
+        return update;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    std::unique_ptr<Thermostat> makeThermostat(ThermostatKind kind)
+    {
+        switch(kind)
+        {
+            case ThermostatKind::Berendsen: return std::make_unique<BerendsenThermostat>();
+            case ThermostatKind::NoseHooverChain: return std::make_unique<NoseHooverChainThermostat>();
+            case ThermostatKind::Langevin: return std::make_unique<LangevinThermostat>();
+            default: return nullptr;
+        }
+    }
+}
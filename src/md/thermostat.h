@@ -0,0 +1,84 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace md
+{
+    // Built-in temperature control schemes
+    enum class ThermostatKind : int
+    {
+        None, // Plain NVE
+        Berendsen, // Weak coupling velocity rescaling. Fast to equilibrate, but doesn't sample the canonical ensemble.
+        NoseHooverChain, // Deterministic extended system, canonical ensemble
+        Langevin // Friction plus random kicks, canonical ensemble
+    };
+
+    // Target and coupling strength, shared by every thermostat. Units are reduced (k_B = 1).
+    struct ThermostatParams
+    {
+        double temperature = 1;
+        double tau = 0.1; // Coupling time of Berendsen and Nose-Hoover
+        double friction = 1; // Langevin collision frequency gamma
+        int chainLength = 3; // Nose-Hoover chain thermostats
+    };
+
+    // Coefficients of the thermostatted velocity update of every atom:
+    //   v' = velocityScale * v + forceScale * h * a + noise * N(0, 1)
+    // Integrators apply it in the same loop as the force kick, so temperature control costs no extra pass over the atoms.
+    struct VelocityUpdate
+    {
+        double velocityScale = 1;
+        double forceScale = 1;
+        double noise = 0; // Standard deviation of the random kick per velocity component, for unit mass. Scaled by 1/sqrt(m).
+    };
+
+    // Integrator stage that controls the temperature through the velocity update
+    class Thermostat
+    {
+    public:
+        virtual ~Thermostat() = default;
+
+        // Coefficients for the next update, from the kinetic energy of the current velocities
+        virtual VelocityUpdate begin(const ThermostatParams& params, double kineticEnergy, int degreesOfFreedom, double h) = 0;
+
+        // Energy stored in the thermostat's own degrees of freedom, for conserved quantity checks
+        virtual double energy(const ThermostatParams&, int /*degreesOfFreedom*/) const { return 0; }
+
+        // Internal state, for checkpoints
+        virtual std::vector<double> state() const { return {}; }
+        virtual void setState(const std::vector<double>&) {}
+    };
+
+    class BerendsenThermostat : public Thermostat
+    {
+    public:
+        VelocityUpdate begin(const ThermostatParams& params, double kineticEnergy, int degreesOfFreedom, double h) override;
+    };
+
+    // Martyna-Tuckerman-Klein chain, propagated with a Trotter split around the velocity scaling
+    class NoseHooverChainThermostat : public Thermostat
+    {
+    public:
+        VelocityUpdate begin(const ThermostatParams& params, double kineticEnergy, int degreesOfFreedom, double h) override;
+        double energy(const ThermostatParams& params, int degreesOfFreedom) const override;
+        std::vector<double> state() const override;
+        void setState(const std::vector<double>& state) override;
+
+    private:
+        double mass(const ThermostatParams& params, int degreesOfFreedom, int i) const;
+
+        std::vector<double> m_position; // xi
+        std::vector<double> m_velocity; // v_xi
+    };
+
+    // Velocity update as the exact Ornstein-Uhlenbeck step after the kick: v' = c (v + h a) + sqrt((1 - c^2) T) N(0, 1)
+    class LangevinThermostat : public Thermostat
+    {
+    public:
+        VelocityUpdate begin(const ThermostatParams& params, double kineticEnergy, int degreesOfFreedom, double h) override;
+    };
+
+    std::unique_ptr<Thermostat> makeThermostat(ThermostatKind kind);
+}
@@ -0,0 +1,117 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace md
+{
+    // Fixed set of worker threads that run the same task in lockstep (fork-join).
+    // The calling thread takes part as thread 0, so a pool of size 1 spawns no workers.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(int numThreads)
+        {
+            for(int t = 1; t < numThreads; ++t)
+                m_workers.emplace_back([this, t]() { workerLoop(t); });
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_quit = true;
+                ++m_generation;
+            }
+            m_wakeUp.notify_all();
+            for(auto& worker : m_workers)
+                worker.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        int size() const { return int(m_workers.size()) + 1; }
+
+        // Run task(threadIndex) once on every thread and wait for all of them to finish
+        void run(const std::function<void(int)>& task)
+        {
+            if(m_workers.empty())
+                return task(0);
+
+            {
+                std::lock_guard lock(m_mutex);
+                m_task = &task;
+                m_pending = int(m_workers.size());
+                ++m_generation;
+            }
+            m_wakeUp.notify_all();
+
+            task(0);
+
+            std::unique_lock lock(m_mutex);
+            m_done.wait(lock, [this]() { return m_pending == 0; });
+            m_task = nullptr;
+        }
+
+        // Split [0, count) into size() contiguous ranges and call fn(begin, end) for each one in parallel.
+        // fn may also take the thread index first, fn(thread, begin, end), to write to per-thread storage.
+        template<class RangeOp>
+        void parallelFor(int count, RangeOp&& fn)
+        {
+            const int numThreads = size();
+            run([&](int t) {
+                const int begin = int(int64_t(count) * t / numThreads);
+                const int end = int(int64_t(count) * (t + 1) / numThreads);
+                if(begin < end)
+                {
+                    if constexpr(std::is_invocable_v<RangeOp&, int, int, int>)
+                        fn(t, begin, end);
+                    else
+                        fn(begin, end);
+                }
+            });
+        }
+
+    private:
+        void workerLoop(int threadIndex)
+        {
+            uint64_t seenGeneration = 0;
+            for(;;)
+            {
+                const std::function<void(int)>* task = nullptr;
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_wakeUp.wait(lock, [&]() { return m_generation != seenGeneration; });
+                    seenGeneration = m_generation;
+                    if(m_quit)
+                        return;
+                    task = m_task;
+                }
+
+                (*task)(threadIndex);
+
+                {
+                    std::lock_guard lock(m_mutex);
+                    --m_pending;
+                }
+                m_done.notify_one();
+            }
+        }
+
+        std::vector<std::thread> m_workers;
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp;
+        std::condition_variable m_done;
+        const std::function<void(int)>* m_task = nullptr;
+        uint64_t m_generation = 0;
+        int m_pending = 0;
+        bool m_quit = false;
+    };
+}
@@ -0,0 +1,377 @@
+// Molecular dynamics playground
+#include "trajectoryWriter.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace md
+{
+    static_assert(std::endian::native == std::endian::little, "Binary trajectories are little-endian");
+
+    namespace
+    {
+        constexpr char QuantizedMagic[8] = { 'A', 'R', 'G', 'O', 'N', 'Q', 'T', 'Z' };
+        constexpr uint32_t QuantizedVersion = 1;
+
+        template<class T>
+        bool writeValue(std::FILE* file, const T& value)
+        {
+            return std::fwrite(&value, sizeof(T), 1, file) == 1;
+        }
+
+        template<class T>
+        bool readValue(std::FILE* file, T& value)
+        {
+            return std::fread(&value, sizeof(T), 1, file) == 1;
+        }
+
+        // Fortran unformatted record: the payload between two copies of its byte length
+        bool writeRecord(std::FILE* file, const void* data, uint32_t bytes)
+        {
+            return writeValue(file, bytes) && std::fwrite(data, 1, bytes, file) == bytes && writeValue(file, bytes);
+        }
+
+        // Signed deltas to unsigned, small magnitudes first, then LEB128 varints
+        void putVarint(std::vector<uint8_t>& out, int32_t delta)
+        {
+            uint32_t v = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+            while(v >= 0x80)
+            {
+                out.push_back(uint8_t(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back(uint8_t(v));
+        }
+
+        bool getVarint(const uint8_t*& p, const uint8_t* end, int32_t& delta)
+        {
+            uint32_t v = 0;
+            for(int shift = 0; shift < 35; shift += 7)
+            {
+                if(p == end)
+                    return false;
+                const uint8_t byte = *p++;
+                v |= uint32_t(byte & 0x7f) << shift;
+                if(!(byte & 0x80))
+                {
+                    delta = int32_t(v >> 1) ^ -int32_t(v & 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void TrajectoryWriter::setSpecies(const std::vector<Species>& species)
+    {
+        m_speciesNames.clear();
+        for(const Species& s : species)
+            m_speciesNames.push_back(s.name);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::open(const std::string& path, TrajectoryFormat format, int numAtoms, double timeStep, int stepsPerFrame,
+        double quantum)
+    {
+        close();
+        m_file = std::fopen(path.c_str(), format == TrajectoryFormat::XYZ ? "w" : "wb");
+        if(!m_file)
+            return false;
+        m_format = format;
+        m_numAtoms = numAtoms;
+        m_timeStep = timeStep;
+        m_stepsPerFrame = std::max(1, stepsPerFrame);
+        m_quantum = quantum;
+        m_numFrames = 0;
+        m_framesWritten = 0;
+        m_ok = writeHeader();
+        for(auto& frame : m_frames)
+        {
+            frame.x.resize(numAtoms);
+            frame.y.resize(numAtoms);
+            frame.z.resize(numAtoms);
+            frame.type.resize(format == TrajectoryFormat::XYZ ? numAtoms : 0);
+        }
+        for(auto& previous : m_previous)
+            previous.assign(numAtoms, 0);
+        m_full[0] = m_full[1] = false;
+        m_producerFrame = 0;
+        m_quit = false;
+        m_thread = std::thread([this]() { writerLoop(); });
+        return m_ok;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::close()
+    {
+        if(!m_file)
+            return true;
+        {
+            std::lock_guard lock(m_mutex);
+            m_quit = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+        if(m_format == TrajectoryFormat::DCD)
+            m_ok = finishDcd() && m_ok;
+        m_ok = std::fclose(m_file) == 0 && m_ok;
+        m_file = nullptr;
+        return m_ok;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::write(const AtomBuffer& atoms, double boxSize, uint64_t step)
+    {
+        const int n = atoms.size();
+        if(!m_file || n != m_numAtoms)
+            return false;
+
+        // Wait for the writer to release this staging frame
+        auto& frame = m_frames[m_producerFrame];
+        {
+            std::unique_lock lock(m_mutex);
+            m_changed.wait(lock, [&]() { return !m_full[m_producerFrame]; });
+        }
+
+        // Column of each atom: its id when ids are dense, otherwise its rank among the ids in use,
+        // so atoms removed by a resize don't scramble the others
+        const int idBound = atoms.idBound();
+        const int* column = atoms.id;
+        if(idBound != n)
+        {
+            m_columns.assign(idBound, 0);
+            for(int i = 0; i < n; ++i)
+                m_columns[atoms.id[i]] = 1;
+            int rank = 0;
+            for(int& c : m_columns)
+            {
+                const int used = c;
+                c = rank;
+                rank += used;
+            }
+            m_ranks.resize(n);
+            for(int i = 0; i < n; ++i)
+                m_ranks[i] = m_columns[atoms.id[i]];
+            column = m_ranks.data();
+        }
+        const auto& pos = atoms.pos;
+        for(int i = 0; i < n; ++i)
+        {
+            const int k = column[i];
+            frame.x[k] = float(pos.x[i]);
+            frame.y[k] = float(pos.y[i]);
+            frame.z[k] = float(pos.z[i]);
+        }
+        if(!frame.type.empty())
+        {
+            for(int i = 0; i < n; ++i)
+                frame.type[column[i]] = atoms.type[i];
+        }
+        frame.step = step;
+        frame.boxSize = boxSize;
+        if(m_numFrames++ == 0)
+            m_firstStep = step;
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_full[m_producerFrame] = true;
+        }
+        m_changed.notify_all();
+        m_producerFrame ^= 1;
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    void TrajectoryWriter::writerLoop()
+    {
+        // Frames are consumed in the order they were filled
+        int current = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock lock(m_mutex);
+                m_changed.wait(lock, [&]() { return m_full[current] || m_quit; });
+                if(!m_full[current])
+                    return; // Quitting, and nothing left to write
+            }
+            if(m_ok)
+                m_ok = writeFrame(m_frames[current]);
+            ++m_framesWritten;
+            {
+                std::lock_guard lock(m_mutex);
+                m_full[current] = false;
+            }
+            m_changed.notify_all();
+            current ^= 1;
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::writeHeader()
+    {
+        switch(m_format)
+        {
+            case TrajectoryFormat::DCD:
+            {
+                // CHARMM layout: 20 control words, of which the frame count and last step are patched on close
+                int32_t control[20] = {};
+                control[2] = m_stepsPerFrame; // NSAVC
+                const float delta = float(m_timeStep);
+                std::memcpy(&control[9], &delta, sizeof(delta));
+                control[10] = 1; // Frames carry a unit cell
+                control[19] = 24; // CHARMM version
+                char header[84];
+                std::memcpy(header, "CORD", 4);
+                std::memcpy(header + 4, control, sizeof(control));
+
+                char titles[4 + 2 * 80];
+                const int32_t numTitles = 2;
+                std::memcpy(titles, &numTitles, 4);
+                std::snprintf(titles + 4, 81, "%-80s", "Lennard-Jones fluid, reduced units");
+                std::snprintf(titles + 84, 81, "%-80s", "Written by the molecular dynamics playground");
+                const int32_t numAtoms = m_numAtoms;
+                return writeRecord(m_file, header, sizeof(header)) && writeRecord(m_file, titles, sizeof(titles))
+                    && writeRecord(m_file, &numAtoms, sizeof(numAtoms));
+            }
+            case TrajectoryFormat::Quantized:
+            {
+                return std::fwrite(QuantizedMagic, 1, sizeof(QuantizedMagic), m_file) == sizeof(QuantizedMagic)
+                    && writeValue(m_file, QuantizedVersion) && writeValue(m_file, int32_t(m_numAtoms)) && writeValue(m_file, m_quantum);
+            }
+            default:
+                return true;
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::writeFrame(const TrajectoryFrame& frame)
+    {
+        switch(m_format)
+        {
+            case TrajectoryFormat::DCD: return writeDcd(frame);
+            case TrajectoryFormat::Quantized: return writeQuantized(frame);
+            default: return writeXyz(frame);
+        }
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::writeXyz(const TrajectoryFrame& frame)
+    {
+        bool ok = std::fprintf(m_file, "%d\nstep %llu box %.6f\n", m_numAtoms, (unsigned long long)frame.step, frame.boxSize) > 0;
+        for(int i = 0; ok && i < m_numAtoms; ++i)
+        {
+            const int t = frame.type[i];
+            const char* name = t >= 0 && t < int(m_speciesNames.size()) ? m_speciesNames[t].c_str() : "Ar";
+            ok = std::fprintf(m_file, "%s %.6f %.6f %.6f\n", name, frame.x[i], frame.y[i], frame.z[i]) > 0;
+        }
+        return ok;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::writeDcd(const TrajectoryFrame& frame)
+    {
+        // Unit cell as A, gamma, B, beta, alpha, C
+        const double cell[6] = { frame.boxSize, 90, frame.boxSize, 90, 90, frame.boxSize };
+        const uint32_t bytes = uint32_t(m_numAtoms * sizeof(float));
+        return writeRecord(m_file, cell, sizeof(cell)) && writeRecord(m_file, frame.x.data(), bytes)
+            && writeRecord(m_file, frame.y.data(), bytes) && writeRecord(m_file, frame.z.data(), bytes);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::finishDcd()
+    {
+        // Patch NSET, ISTART and NSTEP, which are only known at the end
+        const int32_t numFrames = int32_t(m_framesWritten);
+        const int32_t firstStep = int32_t(m_firstStep);
+        const int32_t lastStep = int32_t(m_firstStep + (m_framesWritten ? m_framesWritten - 1 : 0) * m_stepsPerFrame);
+        return std::fseek(m_file, 8, SEEK_SET) == 0 && writeValue(m_file, numFrames) && writeValue(m_file, firstStep)
+            && std::fseek(m_file, 20, SEEK_SET) == 0 && writeValue(m_file, lastStep) && std::fseek(m_file, 0, SEEK_END) == 0;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool TrajectoryWriter::writeQuantized(const TrajectoryFrame& frame)
+    {
+        // Key frames store deltas from zero, so decoding can start from any of them
+        const uint8_t keyFrame = m_framesWritten % KeyFrameInterval == 0;
+        const double invQuantum = 1 / m_quantum;
+        m_encoded.clear();
+        const std::vector<float>* axes[3] = { &frame.x, &frame.y, &frame.z };
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            const float* values = axes[axis]->data();
+            int32_t* previous = m_previous[axis].data();
+            for(int i = 0; i < m_numAtoms; ++i)
+            {
+                const int32_t q = int32_t(std::lround(values[i] * invQuantum));
+                putVarint(m_encoded, q - (keyFrame ? 0 : previous[i]));
+                previous[i] = q;
+            }
+        }
+        return writeValue(m_file, uint32_t(m_encoded.size())) && writeValue(m_file, keyFrame) && writeValue(m_file, frame.step)
+            && writeValue(m_file, frame.boxSize) && std::fwrite(m_encoded.data(), 1, m_encoded.size(), m_file) == m_encoded.size();
+    }
+
+    //----------------------------------------------------------------------------------------------
+    QuantizedTrajectoryReader::~QuantizedTrajectoryReader()
+    {
+        if(m_file)
+            std::fclose(m_file);
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool QuantizedTrajectoryReader::open(const std::string& path)
+    {
+        if(m_file)
+            std::fclose(m_file);
+        m_file = std::fopen(path.c_str(), "rb");
+        char magic[8];
+        uint32_t version = 0;
+        int32_t numAtoms = 0;
+        if(!m_file || std::fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) || std::memcmp(magic, QuantizedMagic, sizeof(magic))
+            || !readValue(m_file, version) || version != QuantizedVersion || !readValue(m_file, numAtoms) || numAtoms < 0
+            || !readValue(m_file, m_quantum))
+        {
+            return false;
+        }
+        m_numAtoms = numAtoms;
+        for(auto& previous : m_previous)
+            previous.assign(numAtoms, 0);
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------------------
+    bool QuantizedTrajectoryReader::next(TrajectoryFrame& frame)
+    {
+        uint32_t bytes = 0;
+        uint8_t keyFrame = 0;
+        if(!m_file || !readValue(m_file, bytes) || !readValue(m_file, keyFrame) || !readValue(m_file, frame.step)
+            || !readValue(m_file, frame.boxSize))
+        {
+            return false;
+        }
+        m_encoded.resize(bytes);
+        if(std::fread(m_encoded.data(), 1, bytes, m_file) != bytes)
+            return false;
+
+        const uint8_t* p = m_encoded.data();
+        const uint8_t* end = p + bytes;
+        std::vector<float>* axes[3] = { &frame.x, &frame.y, &frame.z };
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            axes[axis]->resize(m_numAtoms);
+            float* values = axes[axis]->data();
+            int32_t* previous = m_previous[axis].data();
+            for(int i = 0; i < m_numAtoms; ++i)
+            {
+                int32_t delta;
+                if(!getVarint(p, end, delta))
+                    return false;
+                previous[i] = (keyFrame ? 0 : previous[i]) + delta;
+                values[i] = float(previous[i] * m_quantum);
+            }
+        }
+        return true;
+    }
+}
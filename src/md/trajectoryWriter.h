@@ -0,0 +1,124 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "atomBuffer.h"
+#include "species.h"
+
+namespace md
+{
+    enum class TrajectoryFormat : int
+    {
+        XYZ, // Plain text, one "name x y z" line per atom, named after its species. Large and slow, but readable by anything.
+        DCD, // CHARMM/NAMD binary frames of float coordinates, with the unit cell. Read by VMD, MDAnalysis, MDTraj...
+        Quantized // Coordinates rounded to a fixed quantum and stored as varint deltas from the previous frame
+    };
+
+    // One frame of a trajectory. Atoms are in id order.
+    struct TrajectoryFrame
+    {
+        uint64_t step = 0;
+        double boxSize = 0;
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<int> type; // XYZ only
+    };
+
+    // Trajectory output on a background thread.
+    // write() copies the positions into one of two staging frames and returns. The writer thread encodes and writes
+    // the other one meanwhile, so the integrator only waits when the disk falls more than a frame behind.
+    // Coordinates are in reduced units (sigma), also for DCD, whose readers assume Angstroms.
+    class TrajectoryWriter
+    {
+    public:
+        // Quantum of the quantized format, in units of sigma
+        static constexpr double DefaultQuantum = 1.0 / 1024;
+        // Frames between quantized key frames, which are stored whole so a reader can start from them
+        static constexpr int KeyFrameInterval = 100;
+
+        TrajectoryWriter() = default;
+        ~TrajectoryWriter() { close(); }
+
+        TrajectoryWriter(const TrajectoryWriter&) = delete;
+        TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+        // Start a trajectory of numAtoms atoms. timeStep and stepsPerFrame are recorded in the DCD header.
+        bool open(const std::string& path, TrajectoryFormat format, int numAtoms, double timeStep = 0, int stepsPerFrame = 1,
+            double quantum = DefaultQuantum);
+        // Finish writing the queued frames and close the file. False if anything failed to write.
+        bool close();
+        bool isOpen() const { return m_file != nullptr; }
+        // Species whose names label the atoms of XYZ frames, indexed by atom type. Without them, every atom is written as Ar.
+        // Set before open().
+        void setSpecies(const std::vector<Species>& species);
+
+        // Queue the current positions. Atoms are written in increasing id order, so spatial reordering doesn't shuffle them,
+        // also when a resize left gaps in the ids. False if the atom count differs from open().
+        bool write(const AtomBuffer& atoms, double boxSize, uint64_t step);
+
+        uint64_t numFrames() const { return m_numFrames; }
+
+    private:
+        void writerLoop();
+        bool writeHeader();
+        bool writeFrame(const TrajectoryFrame& frame);
+        bool writeXyz(const TrajectoryFrame& frame);
+        bool writeDcd(const TrajectoryFrame& frame);
+        bool writeQuantized(const TrajectoryFrame& frame);
+        bool finishDcd();
+
+        std::FILE* m_file = nullptr;
+        TrajectoryFormat m_format = TrajectoryFormat::XYZ;
+        int m_numAtoms = 0;
+        double m_timeStep = 0;
+        int m_stepsPerFrame = 1;
+        double m_quantum = DefaultQuantum;
+        std::vector<std::string> m_speciesNames;
+        uint64_t m_numFrames = 0; // Queued by write()
+        uint64_t m_firstStep = 0;
+        // Column of each atom in a frame when ids have gaps, and the rank of each id, for write()
+        std::vector<int> m_ranks;
+        std::vector<int> m_columns;
+
+        // Double buffered staging, handed back and forth under m_mutex
+        TrajectoryFrame m_frames[2];
+        bool m_full[2] = {}; // Frame waits for the writer thread
+        int m_producerFrame = 0;
+        bool m_quit = false;
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::thread m_thread;
+
+        // Owned by the writer thread
+        bool m_ok = true;
+        uint64_t m_framesWritten = 0;
+        std::vector<int32_t> m_previous[3]; // Quantized coordinates of the previous frame
+        std::vector<uint8_t> m_encoded;
+    };
+
+    // Reads back the quantized format, frame by frame
+    class QuantizedTrajectoryReader
+    {
+    public:
+        ~QuantizedTrajectoryReader();
+        bool open(const std::string& path);
+        // False at the end of the file, or on a corrupt frame
+        bool next(TrajectoryFrame& frame);
+        int numAtoms() const { return m_numAtoms; }
+        double quantum() const { return m_quantum; }
+
+    private:
+        std::FILE* m_file = nullptr;
+        int m_numAtoms = 0;
+        double m_quantum = 0;
+        std::vector<int32_t> m_previous[3];
+        std::vector<uint8_t> m_encoded;
+    };
+}
@@ -0,0 +1,219 @@
+// Molecular dynamics playground
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <math/vector.h>
+#include "atomBuffer.h"
+#include "cellList.h"
+#include "periodicBox.h"
+#include "threadPool.h"
+
+namespace md
+{
+    // Split of each list row into an inner and an outer band, for multiple time step integration (see PairBand).
+    // Pairs that may come within switchEnd of each other before the next rebuild are in the inner band,
+    // and pairs that may be beyond switchStart are in the outer band. Pairs in between are in both.
+    struct ListBands
+    {
+        double switchStart = 0;
+        double switchEnd = 0; // 0 disables the split
+
+        bool enabled() const { return switchEnd > 0; }
+        bool operator==(const ListBands&) const = default;
+    };
+
+    // Verlet neighbor list: for each atom i, the atoms within cutoff + skin at build time.
+    // Half lists only keep j > i, so every pair appears once (Newton's third law).
+    // Full lists keep every j != i, so each atom's force can be summed independently of the others.
+    // Stored in compressed rows (offsets + indices) so each atom's neighbors are contiguous.
+    // With bands, each row is ordered inner band only, both bands, outer band only.
+    // The list stays valid until some atom has moved more than skin/2 since the last build, less when the box shrinks.
+    class VerletList
+    {
+    public:
+        // With a thread pool, atoms are split across threads. The resulting list is the same for any thread count.
+        void build(const CellList& cells, const Vec3Stream& pos, int numAtoms, const PeriodicBox& box, double cutoff, double skin,
+            bool halfList = true, ThreadPool* pool = nullptr, const ListBands& bands = {})
+        {
+            m_box = box;
+            m_cutoff = cutoff;
+            m_skin = skin;
+            m_halfList = halfList;
+            m_bands = bands;
+            const double listRadius = cutoff + skin;
+            const double rl2 = listRadius * listRadius;
+            // Atoms move by at most skin/2 each before a rebuild, so pair distances change by at most skin
+            const double innerOnly = bands.switchStart - skin;
+            const double innerOnly2 = innerOnly > 0 ? innerOnly * innerOnly : 0;
+            const double outerOnly2 = (bands.switchEnd + skin) * (bands.switchEnd + skin);
+            auto bandOf = [&](double r2) {
+                if(!bands.enabled() || r2 < innerOnly2)
+                    return 0;
+                return r2 < outerOnly2 ? 1 : 2;
+            };
+
+            // Visit the list neighbors of atom i in a fixed order
+            auto forEachNeighbor = [&](int i, auto&& op) {
+                const double xi = pos.x[i];
+                const double yi = pos.y[i];
+                const double zi = pos.z[i];
+                cells.forEachNearbyAtom(pos[i], [&](int j) {
+                    if(halfList ? j <= i : j == i)
+                        return;
+                    const double dx = box.minimumImage(pos.x[j] - xi);
+                    const double dy = box.minimumImage(pos.y[j] - yi);
+                    const double dz = box.minimumImage(pos.z[j] - zi);
+                    const double r2 = dx * dx + dy * dy + dz * dz;
+                    if(r2 < rl2)
+                        op(j, r2);
+                });
+            };
+
+            // Pass the inner band only neighbors of atom i to emit, and stage the others in middle and outer,
+            // so rows can be written in band order
+            auto splitRow = [&](int i, auto&& emit, std::vector<int>& middle, std::vector<int>& outer) {
+                middle.clear();
+                outer.clear();
+                forEachNeighbor(i, [&](int j, double r2) {
+                    switch(bandOf(r2))
+                    {
+                        case 0: emit(j); break;
+                        case 1: middle.push_back(j); break;
+                        default: outer.push_back(j); break;
+                    }
+                });
+            };
+
+            m_offsets.resize(numAtoms + 1);
+            m_innerEnds.resize(numAtoms);
+            m_outerBegins.resize(numAtoms);
+            if(!pool)
+            {
+                m_neighbors.clear();
+                for(int i = 0; i < numAtoms; ++i)
+                {
+                    m_offsets[i] = int(m_neighbors.size());
+                    splitRow(i, [&](int j) { m_neighbors.push_back(j); }, m_middle, m_outer);
+                    m_outerBegins[i] = int(m_neighbors.size());
+                    m_neighbors.insert(m_neighbors.end(), m_middle.begin(), m_middle.end());
+                    m_innerEnds[i] = int(m_neighbors.size());
+                    m_neighbors.insert(m_neighbors.end(), m_outer.begin(), m_outer.end());
+                }
+                m_offsets[numAtoms] = int(m_neighbors.size());
+            }
+            else
+            {
+                // Count, then fill each row in place
+                m_offsets[0] = 0;
+                pool->parallelFor(numAtoms, [&](int begin, int end) {
+                    for(int i = begin; i < end; ++i)
+                    {
+                        int count = 0;
+                        forEachNeighbor(i, [&](int, double) { ++count; });
+                        m_offsets[i + 1] = count;
+                    }
+                });
+                for(int i = 0; i < numAtoms; ++i)
+                    m_offsets[i + 1] += m_offsets[i];
+                m_neighbors.resize(m_offsets[numAtoms]);
+                pool->parallelFor(numAtoms, [&](int begin, int end) {
+                    std::vector<int> middle;
+                    std::vector<int> outer;
+                    for(int i = begin; i < end; ++i)
+                    {
+                        int k = m_offsets[i];
+                        splitRow(i, [&](int j) { m_neighbors[k++] = j; }, middle, outer);
+                        m_outerBegins[i] = k;
+                        k = int(std::copy(middle.begin(), middle.end(), m_neighbors.begin() + k) - m_neighbors.begin());
+                        m_innerEnds[i] = k;
+                        std::copy(outer.begin(), outer.end(), m_neighbors.begin() + k);
+                    }
+                });
+            }
+
+            m_referenceX.assign(pos.x, pos.x + numAtoms);
+            m_referenceY.assign(pos.y, pos.y + numAtoms);
+            m_referenceZ.assign(pos.z, pos.z + numAtoms);
+            ++m_numBuilds;
+            m_totalListLength += m_neighbors.size();
+        }
+
+        // True if the list was built for a different interaction range, kind or bands.
+        // A resized box doesn't invalidate the list by itself, see needsRebuild.
+        bool isStale(const PeriodicBox& box, double cutoff, double skin, bool halfList = true, const ListBands& bands = {}) const
+        {
+            return m_offsets.empty() || cutoff != m_cutoff || skin != m_skin || halfList != m_halfList
+                || box.periodic != m_box.periodic || !(bands == m_bands);
+        }
+
+        // Size of the box at the last build over the current one, to map positions back to the build frame
+        double referenceScale(double boxSize) const { return m_box.size / boxSize; }
+
+        // Squared displacement of atom i since the list was last built, measured in the build frame.
+        // scale is referenceScale() of the current box, so a uniform box rescaling alone doesn't move atoms.
+        double displacement2(int i, double x, double y, double z, double scale = 1) const
+        {
+            const double dx = m_box.minimumImage(x * scale - m_referenceX[i]);
+            const double dy = m_box.minimumImage(y * scale - m_referenceY[i]);
+            const double dz = m_box.minimumImage(z * scale - m_referenceZ[i]);
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        // Rebuild criterion: some pair may have entered the cutoff.
+        // In the build frame, pairs outside the list were at least cutoff + skin apart and got closer by at most
+        // twice the largest displacement. Scaled to the current box, they must still be beyond the cutoff, which
+        // leaves skin - cutoff (referenceScale - 1) for the atoms to move. For a fixed box, that is the usual skin/2 rule.
+        bool needsRebuild(double maxDisplacement2, double boxSize) const
+        {
+            const double margin = m_skin - m_cutoff * (referenceScale(boxSize) - 1);
+            return margin <= 0 || 4 * maxDisplacement2 > margin * margin;
+        }
+
+        int neighborsBegin(int i) const { return m_offsets[i]; }
+        int neighborsEnd(int i) const { return m_offsets[i + 1]; }
+        const int* neighborIndices() const { return m_neighbors.data(); }
+        const int* offsets() const { return m_offsets.data(); }
+        // Band limits of each row: the inner band is [offsets[i], innerEnds[i]), the outer band [outerBegins[i], offsets[i+1]).
+        // Without bands, every neighbor is in the inner band.
+        const int* innerEnds() const { return m_innerEnds.data(); }
+        const int* outerBegins() const { return m_outerBegins.data(); }
+
+        // Tuning statistics
+        uint64_t numBuilds() const { return m_numBuilds; }
+        double averageListLength() const
+        {
+            const int numAtoms = int(m_referenceX.size());
+            if(!m_numBuilds || !numAtoms)
+                return 0;
+            return double(m_totalListLength) / (double(m_numBuilds) * numAtoms);
+        }
+
+        void resetStats()
+        {
+            m_numBuilds = 0;
+            m_totalListLength = 0;
+        }
+
+    private:
+        PeriodicBox m_box;
+        double m_cutoff = 0;
+        double m_skin = 0;
+        bool m_halfList = true;
+        ListBands m_bands;
+        std::vector<int> m_offsets; // numAtoms+1 offsets into m_neighbors
+        std::vector<int> m_innerEnds;
+        std::vector<int> m_outerBegins;
+        std::vector<int> m_neighbors;
+        std::vector<int> m_middle; // Band staging of the serial build
+        std::vector<int> m_outer;
+        // Positions at the last build
+        std::vector<double> m_referenceX;
+        std::vector<double> m_referenceY;
+        std::vector<double> m_referenceZ;
+
+        uint64_t m_numBuilds = 0;
+        uint64_t m_totalListLength = 0; // Sum of list sizes over all builds
+    };
+}
@@ -0,0 +1,542 @@
+// Molecular dynamics playground
+// Headless batch runner: steps the simulation as fast as possible and reports throughput.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cmdLineParser.h"
+#include <md/argonSimulation.h>
+#include <md/trajectoryWriter.h>
+
+namespace
+{
+    bool parseBackend(const std::string& name, md::ArgonSimulation::ForceBackend& backend)
+    {
+        using Backend = md::ArgonSimulation::ForceBackend;
+        if(name == "brute") backend = Backend::BruteForce;
+        else if(name == "cells") backend = Backend::CellList;
+        else if(name == "verlet") backend = Backend::VerletList;
+        else if(name == "threaded") backend = Backend::Threaded;
+        else if(name == "domains") backend = Backend::Domains;
+        else return false;
+        return true;
+    }
+
+    bool parseSimdLevel(const std::string& name, md::SimdLevel& level)
+    {
+        if(name == "scalar") level = md::SimdLevel::Scalar;
+        else if(name == "sse") level = md::SimdLevel::SSE;
+        else if(name == "avx2") level = md::SimdLevel::AVX2;
+        else if(name == "avx512") level = md::SimdLevel::AVX512;
+        else return false;
+        return true;
+    }
+
+    bool parseCurve(const std::string& name, md::SpaceFillingCurve& curve)
+    {
+        if(name == "morton") curve = md::SpaceFillingCurve::Morton;
+        else if(name == "hilbert") curve = md::SpaceFillingCurve::Hilbert;
+        else return false;
+        return true;
+    }
+
+    bool parseThermostat(const std::string& name, md::ThermostatKind& kind)
+    {
+        if(name == "none") kind = md::ThermostatKind::None;
+        else if(name == "berendsen") kind = md::ThermostatKind::Berendsen;
+        else if(name == "nhc") kind = md::ThermostatKind::NoseHooverChain;
+        else if(name == "langevin") kind = md::ThermostatKind::Langevin;
+        else return false;
+        return true;
+    }
+
+    bool parseBarostat(const std::string& name, md::BarostatKind& kind)
+    {
+        if(name == "none") kind = md::BarostatKind::None;
+        else if(name == "berendsen") kind = md::BarostatKind::Berendsen;
+        else if(name == "mtk") kind = md::BarostatKind::MTK;
+        else return false;
+        return true;
+    }
+
+    // MSD and VACF tables, and the diffusion coefficient from both: the Einstein relation MSD = 6 D t at the longest lag,
+    // and the Green-Kubo integral D = 1/3 int VACF dt up to the longest lag
+    void printCorrelations(const md::ArgonSimulation& sim, double lagTime)
+    {
+        std::vector<double> lags, msd, vacfLags, vacf;
+        sim.meanSquaredDisplacement().result(lags, msd);
+        sim.velocityAutocorrelation().result(vacfLags, vacf);
+        std::printf("time msd vacf:\n");
+        double integral = 0;
+        for(size_t k = 0; k < lags.size(); ++k)
+        {
+            std::printf("%.5g %.6g %.6g\n", lags[k] * lagTime, msd[k], vacf[k]);
+            if(k > 0)
+                integral += 0.5 * (vacf[k] + vacf[k - 1]) * (vacfLags[k] - vacfLags[k - 1]) * lagTime;
+        }
+        if(lags.size() > 1)
+        {
+            std::printf("diffusion: einstein %.5g, green-kubo %.5g\n",
+                msd.back() / (6 * lags.back() * lagTime), integral / 3);
+        }
+    }
+
+    bool parseInitialPositions(const std::string& name, md::ArgonSimulation::InitialPositions& positions)
+    {
+        using Positions = md::ArgonSimulation::InitialPositions;
+        if(name == "fcc") positions = Positions::FCC;
+        else if(name == "scatter") positions = Positions::Scatter;
+        else return false;
+        return true;
+    }
+
+    // Tabulated pair potential by name, with parameters matching the depth and location of the Lennard-Jones well
+    // so that the same densities and temperatures stay sensible. "lj" keeps the analytic kernels.
+    // Only lj-table follows the species: the other forms are the same for every pair.
+    bool parsePotential(const std::string& name, const md::ArgonSimulation::Config& config,
+        std::shared_ptr<const md::PairTable>& table)
+    {
+        md::PairPotential potential;
+        const double rMin = std::pow(2.0, 1.0 / 6);
+        if(name == "lj")
+        {
+            table = nullptr;
+            return true;
+        }
+        else if(name == "lj-table") potential = md::PairPotential::lennardJones();
+        else if(name == "morse") potential = md::PairPotential::morse(1, std::sqrt(36 / std::cbrt(2.0)), rMin);
+        else if(name == "buckingham") potential = md::PairPotential::buckingham(0.75 * std::exp(14.0), rMin / 14, 3.5);
+        else return false;
+        const int numTypes = std::max(1, int(config.species.size()));
+        auto pairTable = std::make_shared<md::PairTable>(numTypes, 0.7, config.cutoff);
+        for(int a = 0; a < numTypes; ++a)
+        {
+            for(int b = a; b < numTypes; ++b)
+            {
+                if(name == "lj-table" && !config.species.empty())
+                {
+                    const md::Species& sa = config.species[a];
+                    const md::Species& sb = config.species[b];
+                    potential = md::PairPotential::lennardJones(std::sqrt(sa.epsilon * sb.epsilon), (sa.sigma + sb.sigma) / 2);
+                }
+                pairTable->set(a, b, potential, config.shiftedForce);
+            }
+        }
+        table = std::move(pairTable);
+        return true;
+    }
+
+    // Argon and krypton in argon units: epsilon/k_B = 119.8 K and 171 K, sigma = 3.405 and 3.60 A, 39.95 and 83.80 u
+    std::vector<md::Species> argonKrypton(double kryptonFraction)
+    {
+        md::Species argon;
+        md::Species krypton;
+        krypton.name = "Kr";
+        krypton.mass = 83.80 / 39.95;
+        krypton.epsilon = 171.0 / 119.8;
+        krypton.sigma = 3.60 / 3.405;
+        argon.fraction = 1 - kryptonFraction;
+        krypton.fraction = kryptonFraction;
+        return { argon, krypton };
+    }
+
+    // Conserved energy per atom sampled along a run, with its least squares drift and the fluctuation around it
+    struct EnergyDrift
+    {
+        double drift = 0; // Slope, per atom and unit time
+        double fluctuation = 0; // RMS residual of the linear fit, per atom
+        double seconds = 0;
+    };
+
+    EnergyDrift measureEnergyDrift(md::ArgonSimulation& sim, int numSteps, int sampleInterval)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<double> times, energies;
+        // The energies are only known after the first step
+        for(int i = 1; i <= numSteps; ++i)
+        {
+            sim.step();
+            if(i % sampleInterval == 0)
+            {
+                times.push_back(sim.stepCount() * sim.config.timeStep);
+                energies.push_back((sim.totalEnergy() + sim.extendedEnergy()) / sim.numAtoms());
+            }
+        }
+        EnergyDrift result;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const size_t n = times.size();
+        double meanT = 0, meanE = 0;
+        for(size_t k = 0; k < n; ++k)
+        {
+            meanT += times[k] / n;
+            meanE += energies[k] / n;
+        }
+        double stt = 0, ste = 0;
+        for(size_t k = 0; k < n; ++k)
+        {
+            stt += (times[k] - meanT) * (times[k] - meanT);
+            ste += (times[k] - meanT) * (energies[k] - meanE);
+        }
+        result.drift = stt > 0 ? ste / stt : 0;
+        double residual2 = 0;
+        for(size_t k = 0; k < n; ++k)
+        {
+            const double residual = energies[k] - meanE - result.drift * (times[k] - meanT);
+            residual2 += residual * residual;
+        }
+        result.fluctuation = std::sqrt(residual2 / n);
+        return result;
+    }
+
+    // Run the same system in double and mixed precision and compare the drift of the conserved energy
+    int runDriftTest(md::ArgonSimulation::Config config, int numSteps, const std::string& loadPath)
+    {
+        const int sampleInterval = std::max(1, numSteps / 1000);
+        EnergyDrift drifts[2];
+        const md::PairPrecision precisions[2] = { md::PairPrecision::Double, md::PairPrecision::Mixed };
+        for(int k = 0; k < 2; ++k)
+        {
+            config.precision = precisions[k];
+            md::ArgonSimulation sim(config);
+            if(!sim.usesNeighborList())
+            {
+                std::fprintf(stderr, "The drift test needs a Verlet list backend\n");
+                return -1;
+            }
+            if(!loadPath.empty() && !sim.loadCheckpoint(loadPath))
+            {
+                std::fprintf(stderr, "Can't load checkpoint: %s\n", loadPath.c_str());
+                return -1;
+            }
+            if(k == 0)
+            {
+                std::printf("drift test: %d atoms, %d steps of %g, simd: %s\n", sim.numAtoms(), numSteps, config.timeStep,
+                    md::simdLevelName(config.simdLevel));
+            }
+            drifts[k] = measureEnergyDrift(sim, numSteps, sampleInterval);
+            std::printf("%-6s  drift %+.4e /atom/time  fluctuation %.4e /atom  wall time %.3f s\n",
+                md::pairPrecisionName(precisions[k]), drifts[k].drift, drifts[k].fluctuation, drifts[k].seconds);
+        }
+        std::printf("mixed / double: drift %.3g, fluctuation %.3g, speedup %.3g\n", drifts[1].drift / drifts[0].drift,
+            drifts[1].fluctuation / drifts[0].fluctuation, drifts[0].seconds / drifts[1].seconds);
+        return 0;
+    }
+
+    bool parseTrajectoryFormat(const std::string& name, md::TrajectoryFormat& format)
+    {
+        if(name == "xyz") format = md::TrajectoryFormat::XYZ;
+        else if(name == "dcd") format = md::TrajectoryFormat::DCD;
+        else if(name == "qtz") format = md::TrajectoryFormat::Quantized;
+        else return false;
+        return true;
+    }
+
+    void printUsage()
+    {
+        std::puts(
+            "usage: md_run [options]\n"
+            "  --steps <n>        Number of time steps (default 1000)\n"
+            "  --atoms <n>        Number of atoms\n"
+            "  --box <size>       Box edge length, in units of sigma\n"
+            "  --density <rho>    Atoms per sigma^3, sizes the box instead of --box\n"
+            "  --init <name>      fcc | scatter (default fcc)\n"
+            "  --init-temperature <T> Maxwell-Boltzmann starting temperature (default 1, 0: at rest)\n"
+            "  --dt <h>           Time step\n"
+            "  --respa <k>        r-RESPA inner steps per time step, with Verlet list backends (default 1: off)\n"
+            "  --respa-cutoff <r> Split radius between the inner and outer forces\n"
+            "  --respa-switch <w> Width of the switching region below the split radius\n"
+            "  --seed <n>         Seed of the initial scatter and velocities\n"
+            "  --backend <name>   brute | cells | verlet | threaded | domains\n"
+            "  --cutoff <r>       Interaction cutoff radius\n"
+            "  --skin <r>         Verlet list skin\n"
+            "  --threads <n>      Threads of the threaded backend, or domains of the domains backend\n"
+            "  --pin              Pin domain threads to CPUs, one NUMA node after the other\n"
+            "  --simd <name>      scalar | sse | avx2 | avx512 (default: best available)\n"
+            "  --reorder <n>      Reorder atoms in memory at most every n steps (default 0: never)\n"
+            "  --curve <name>     morton | hilbert (default hilbert)\n"
+            "  --thermostat <name> none | berendsen | nhc | langevin (default none)\n"
+            "  --temperature <T>  Thermostat target temperature\n"
+            "  --tau <t>          Berendsen and Nose-Hoover coupling time\n"
+            "  --friction <g>     Langevin friction\n"
+            "  --chain <n>        Nose-Hoover chain length\n"
+            "  --barostat <name>  none | berendsen | mtk (default none)\n"
+            "  --pressure <P>     Barostat target pressure\n"
+            "  --ptau <t>         Barostat coupling time\n"
+            "  --compressibility <b> Berendsen barostat compressibility\n"
+            "  --log <n>          Print the observables every n steps (default 0: never)\n"
+            "  --rdf <n>          Sample g(r) every n steps and print it at the end (default 0: never)\n"
+            "  --rdf-bins <n>     Histogram bins of g(r)\n"
+            "  --correlate <n>    Sample MSD and VACF every n steps and print them at the end (default 0: never)\n"
+            "  --load <path>      Start from a checkpoint instead of a scatter\n"
+            "  --save <path>      Write a checkpoint after the last step\n"
+            "  --traj <path>      Write a trajectory\n"
+            "  --traj-format <name> xyz | dcd | qtz (quantized deltas, default)\n"
+            "  --traj-interval <n> Steps between trajectory frames (default 100)\n"
+            "  --precision <name> double | float | mixed: Verlet list forces in double, float, or float pair evaluation\n"
+            "                     with double positions and sums (default double)\n"
+            "  --float            Same as --precision float\n"
+            "  --drift-test       Run in double and mixed precision for --steps each and compare their energy drift\n"
+            "  --shifted          Use the shifted-force potential\n"
+            "  --potential <name> lj | lj-table | morse | buckingham, all but lj tabulated (default lj)\n"
+            "  --krypton <x>      Argon-krypton mixture with this fraction of krypton (default 0: pure argon)\n"
+            "  --no-pbc           Reflecting walls instead of periodic boundary conditions\n"
+            "  --help             Show this message");
+    }
+}
+
+int main(int argc, const char** argv)
+{
+    md::ArgonSimulation::Config config;
+    config.numAtoms = 4096;
+    config.boxSize = 20;
+    config.initialPositions = md::ArgonSimulation::InitialPositions::FCC;
+    config.initialTemperature = 1;
+    config.forceBackend = md::ArgonSimulation::ForceBackend::VerletList;
+    int numSteps = 1000;
+    int logInterval = 0;
+    std::string loadPath;
+    std::string savePath;
+    std::string trajectoryPath;
+    std::string trajectoryFormatName;
+    int trajectoryInterval = 100;
+    double kryptonFraction = 0;
+    std::string initName;
+    std::string backendName;
+    std::string simdName;
+    std::string curveName;
+    std::string thermostatName;
+    std::string barostatName;
+    std::string potentialName;
+    std::string precisionName;
+    bool singlePrecision = false;
+    bool driftTest = false;
+    bool noPbc = false;
+    bool help = false;
+
+    CmdLineParser parser;
+    parser.addOption("steps", &numSteps);
+    parser.addOption("atoms", &config.numAtoms);
+    parser.addOption("box", &config.boxSize);
+    parser.addOption("density", &config.density);
+    parser.addOption("init", &initName);
+    parser.addOption("init-temperature", &config.initialTemperature);
+    parser.addOption("dt", &config.timeStep);
+    parser.addOption("respa", &config.respaSteps);
+    parser.addOption("respa-cutoff", &config.respaCutoff);
+    parser.addOption("respa-switch", &config.respaSwitch);
+    parser.addOption("seed", &config.seed);
+    parser.addOption("backend", &backendName);
+    parser.addOption("cutoff", &config.cutoff);
+    parser.addOption("skin", &config.skin);
+    parser.addOption("threads", &config.numThreads);
+    parser.addOption("simd", &simdName);
+    parser.addOption("reorder", &config.reorderInterval);
+    parser.addOption("curve", &curveName);
+    parser.addOption("thermostat", &thermostatName);
+    parser.addOption("temperature", &config.thermostatParams.temperature);
+    parser.addOption("tau", &config.thermostatParams.tau);
+    parser.addOption("friction", &config.thermostatParams.friction);
+    parser.addOption("chain", &config.thermostatParams.chainLength);
+    parser.addOption("barostat", &barostatName);
+    parser.addOption("pressure", &config.barostatParams.pressure);
+    parser.addOption("ptau", &config.barostatParams.tau);
+    parser.addOption("compressibility", &config.barostatParams.compressibility);
+    parser.addOption("potential", &potentialName);
+    parser.addOption("krypton", &kryptonFraction);
+    parser.addOption("log", &logInterval);
+    parser.addOption("rdf", &config.rdfInterval);
+    parser.addOption("rdf-bins", &config.rdfBins);
+    parser.addOption("correlate", &config.correlatorInterval);
+    parser.addOption("load", &loadPath);
+    parser.addOption("save", &savePath);
+    parser.addOption("traj", &trajectoryPath);
+    parser.addOption("traj-format", &trajectoryFormatName);
+    parser.addOption("traj-interval", &trajectoryInterval);
+    parser.addOption("precision", &precisionName);
+    parser.addFlag("float", singlePrecision);
+    parser.addFlag("drift-test", driftTest);
+    parser.addFlag("shifted", config.shiftedForce);
+    parser.addFlag("no-pbc", noPbc);
+    parser.addFlag("pin", config.pinThreads);
+    parser.addFlag("help", help);
+    parser.parse(argc, argv);
+
+    if(help)
+    {
+        printUsage();
+        return 0;
+    }
+    if(!initName.empty() && !parseInitialPositions(initName, config.initialPositions))
+    {
+        std::fprintf(stderr, "Unknown initial positions: %s\n", initName.c_str());
+        return -1;
+    }
+    if(!backendName.empty() && !parseBackend(backendName, config.forceBackend))
+    {
+        std::fprintf(stderr, "Unknown backend: %s\n", backendName.c_str());
+        return -1;
+    }
+    if(!simdName.empty())
+    {
+        md::SimdLevel level;
+        if(!parseSimdLevel(simdName, level) || level > md::detectSimdLevel())
+        {
+            std::fprintf(stderr, "Unsupported SIMD level: %s\n", simdName.c_str());
+            return -1;
+        }
+        config.simdLevel = level;
+    }
+    if(singlePrecision)
+        config.precision = md::PairPrecision::Single;
+    if(!precisionName.empty() && !md::parsePairPrecision(precisionName, config.precision))
+    {
+        std::fprintf(stderr, "Unknown precision: %s\n", precisionName.c_str());
+        return -1;
+    }
+    if(!curveName.empty() && !parseCurve(curveName, config.reorderCurve))
+    {
+        std::fprintf(stderr, "Unknown curve: %s\n", curveName.c_str());
+        return -1;
+    }
+    if(!thermostatName.empty() && !parseThermostat(thermostatName, config.thermostat))
+    {
+        std::fprintf(stderr, "Unknown thermostat: %s\n", thermostatName.c_str());
+        return -1;
+    }
+    if(!barostatName.empty() && !parseBarostat(barostatName, config.barostat))
+    {
+        std::fprintf(stderr, "Unknown barostat: %s\n", barostatName.c_str());
+        return -1;
+    }
+    if(kryptonFraction < 0 || kryptonFraction > 1)
+    {
+        std::fprintf(stderr, "Krypton fraction out of [0, 1]: %g\n", kryptonFraction);
+        return -1;
+    }
+    if(kryptonFraction > 0)
+        config.species = argonKrypton(kryptonFraction);
+    if(!potentialName.empty() && !parsePotential(potentialName, config, config.pairTable))
+    {
+        std::fprintf(stderr, "Unknown potential: %s\n", potentialName.c_str());
+        return -1;
+    }
+    md::TrajectoryFormat trajectoryFormat = md::TrajectoryFormat::Quantized;
+    if(!trajectoryFormatName.empty() && !parseTrajectoryFormat(trajectoryFormatName, trajectoryFormat))
+    {
+        std::fprintf(stderr, "Unknown trajectory format: %s\n", trajectoryFormatName.c_str());
+        return -1;
+    }
+    trajectoryInterval = std::max(1, trajectoryInterval);
+    config.periodic = !noPbc;
+    config.observableInterval = std::max(0, logInterval);
+    if(config.numAtoms <= 0 || numSteps < 0)
+    {
+        printUsage();
+        return -1;
+    }
+    if(driftTest)
+        return runDriftTest(config, numSteps, loadPath);
+
+    md::ArgonSimulation sim(config);
+    if(!loadPath.empty())
+    {
+        const auto loadStart = std::chrono::steady_clock::now();
+        if(!sim.loadCheckpoint(loadPath))
+        {
+            std::fprintf(stderr, "Can't load checkpoint: %s\n", loadPath.c_str());
+            return -1;
+        }
+        config.numAtoms = sim.numAtoms();
+        std::printf("loaded %s: %d atoms at step %llu in %.3f ms\n", loadPath.c_str(), sim.numAtoms(), (unsigned long long)sim.stepCount(),
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count());
+    }
+
+    md::TrajectoryWriter trajectory;
+    trajectory.setSpecies(sim.config.species);
+    if(!trajectoryPath.empty()
+        && !trajectory.open(trajectoryPath, trajectoryFormat, sim.numAtoms(), config.timeStep, trajectoryInterval))
+    {
+        std::fprintf(stderr, "Can't write trajectory: %s\n", trajectoryPath.c_str());
+        return -1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    md::Observables o;
+    for(int i = 0; i < numSteps; ++i)
+    {
+        sim.step();
+        if(trajectory.isOpen() && sim.stepCount() % trajectoryInterval == 0)
+            trajectory.write(sim.particles(), sim.boxSize(), sim.stepCount());
+        while(sim.observables().pop(o))
+        {
+            std::printf("step %llu  t %.4f  T %.4f  P %.4f  KE %.6g  PE %.6g  E %.8g\n", (unsigned long long)o.step, o.time,
+                o.temperature, o.pressure, o.kineticEnergy, o.potentialEnergy, o.totalEnergy() + o.extendedEnergy);
+        }
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    md::CheckpointWriter checkpointWriter;
+    if(!savePath.empty() && !sim.saveCheckpoint(checkpointWriter, savePath))
+    {
+        std::fprintf(stderr, "Can't save checkpoint: %s\n", savePath.c_str());
+        return -1;
+    }
+
+    const double atomSteps = double(config.numAtoms) * numSteps;
+    std::printf("atoms: %d, steps: %d, simd: %s (%s)\n", config.numAtoms, numSteps,
+        md::simdLevelName(config.simdLevel), md::pairPrecisionName(config.precision));
+    std::printf("wall time: %.3f s\n", seconds);
+    std::printf("steps/s: %.1f\n", numSteps / seconds);
+    std::printf("atom-steps/s: %.4g\n", atomSteps / seconds);
+    if(sim.usesNeighborList())
+    {
+        std::printf("list rebuilds: %llu, avg. neighbors per atom: %.2f\n",
+            (unsigned long long)sim.neighbors().numBuilds(), sim.neighbors().averageListLength());
+    }
+    if(const md::DomainDecomposition* domains = sim.domains())
+    {
+        const auto& grid = domains->grid();
+        std::printf("domains: %dx%dx%d, list rebuilds: %llu, migrations: %llu, ghosts per owned atom: %.2f\n", grid[0], grid[1],
+            grid[2], (unsigned long long)domains->numRebuilds(), (unsigned long long)domains->numMigrations(), domains->ghostRatio());
+        if(domains->numUnpinned() > 0)
+            std::fprintf(stderr, "Couldn't pin %d of %d domain threads\n", domains->numUnpinned(), domains->numDomains());
+    }
+    std::printf("temperature: %.4f\n", sim.temperature());
+    std::printf("pressure: %.4f\n", sim.pressure());
+    std::printf("energy: kinetic %.6g, potential %.6g, total %.8g\n", sim.kineticEnergy(), sim.potentialEnergy(), sim.totalEnergy());
+    if(config.barostat != md::BarostatKind::None)
+        std::printf("box: %.4f, density: %.4f\n", sim.boxSize(), sim.numAtoms() / sim.volume());
+    if(config.reorderInterval > 0)
+        std::printf("reorders: %llu\n", (unsigned long long)sim.numReorders());
+    if(sim.meanSquaredDisplacement().numSamples() > 1)
+        printCorrelations(sim, config.correlatorInterval * config.timeStep);
+    if(trajectory.isOpen())
+    {
+        const uint64_t numFrames = trajectory.numFrames();
+        if(!trajectory.close())
+        {
+            std::fprintf(stderr, "Can't write trajectory: %s\n", trajectoryPath.c_str());
+            return -1;
+        }
+        std::printf("trajectory: %llu frames\n", (unsigned long long)numFrames);
+    }
+    if(!savePath.empty() && !checkpointWriter.wait())
+    {
+        std::fprintf(stderr, "Can't write checkpoint: %s\n", savePath.c_str());
+        return -1;
+    }
+    auto& rdf = sim.radialDistribution();
+    if(rdf.numSamples() > 0)
+    {
+        std::printf("g(r) over %llu samples:\n", (unsigned long long)rdf.numSamples());
+        const auto& g = rdf.values();
+        for(int b = 0; b < rdf.numBins(); ++b)
+            std::printf("%.4f %.5f\n", rdf.binCenter(b), g[b]);
+    }
+    return 0;
+}